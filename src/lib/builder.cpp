@@ -0,0 +1,89 @@
+#include "gc.h"
+#include "object.h"
+#include "vm.h"
+
+
+Object Object::StringBuilder()
+{
+    Object obj = GC::alloc<StringBuilder_>();
+    obj.set_type(Type::StringBuilder);
+    obj.deref<StringBuilder_>()->size = 0;
+    return obj;
+}
+
+// Append a string or the contents of another builder, sharing long
+// strings rather than copying them
+void Object::builder_append(Object str)
+{
+    if (str.type() == Type::StringBuilder) {
+        // Copy the parts first, in case str is this builder
+        std::vector<BuilderChunk> chunks = str.builder_chunks();
+        std::string small = str.deref<StringBuilder_>()->small;
+        std::size_t pos = 0;
+        for (const BuilderChunk& chunk : chunks) {
+            builder_append(std::string_view(small).substr(pos, chunk.at - pos));
+            builder_append(chunk.str);
+            pos = chunk.at;
+        }
+        builder_append(std::string_view(small).substr(pos));
+        return;
+    }
+
+    std::string_view text = str.text();
+    if (text.size() < BUILDER_SHARE_SIZE) {
+        builder_append(text);
+        return;
+    }
+    StringBuilder_* builder = deref<StringBuilder_>();
+    builder->chunks.push_back({ str, builder->small.size() });
+    builder->size += text.size();
+}
+
+void Object::builder_append(std::string_view text)
+{
+    StringBuilder_* builder = deref<StringBuilder_>();
+    builder->small.append(text);
+    builder->size += text.size();
+}
+
+
+Object VM::StringBuilder()
+{
+    Object ret = Object::StringBuilder();
+    push(ret);
+    return ret;
+}
+
+// Append the string on top of the stack to the builder below it, leaving
+// the builder
+void Op::builder_append()
+{
+    Object str = VM::peek();
+    CHECK_ARGS(str.type() == Type::String || str.type() == Type::StringBuilder,
+          2, type, "builder-append!: not a string");
+    VM::peek(1).builder_append(str);
+    VM::pop();
+}
+
+void Op::builder_string()
+{
+    Object obj = VM::peek();
+    const std::vector<BuilderChunk>& chunks = obj.builder_chunks();
+    StringBuilder_* builder = obj.deref<StringBuilder_>();
+
+    // Already flat: a single chunk and nothing around it
+    if (chunks.size() == 1 && builder->small.empty()) {
+        VM::push(chunks[0].str, 1);
+        return;
+    }
+
+    std::string data;
+    data.reserve(builder->size);
+    obj.builder_pieces([&] (std::string_view piece) { data.append(piece); });
+    Object str = Object::String(data);
+
+    // Keep the result, so that flattening again is free
+    builder->chunks.assign(1, { str, 0 });
+    builder->small.clear();
+    VM::push(str, 1);
+}
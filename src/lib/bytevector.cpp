@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <cstring>
+
+#include "object.h"
+#include "simd.h"
+#include "vm.h"
+
+
+// The bulk operations below go through memset, memmove and memcmp, which
+// the C library already implements with the widest vector unit available
+
+void Object::fill_bytes(uint8_t value, std::size_t start, std::size_t end)
+{
+    std::memset(bytes() + start, value, end - start);
+}
+
+void Object::copy_bytes(std::size_t at, Object from, std::size_t start, std::size_t end)
+{
+    std::memmove(bytes() + at, from.bytes() + start, end - start);
+}
+
+int Object::compare_bytes(Object other) const
+{
+    std::size_t common = std::min(nbytes(), other.nbytes());
+    int cmp = std::memcmp(bytes(), other.bytes(), common);
+    if (cmp != 0)
+        return cmp < 0 ? -1 : 1;
+    return nbytes() == other.nbytes() ? 0 : nbytes() < other.nbytes() ? -1 : 1;
+}
+
+std::size_t Object::search_bytes(Object needle, std::size_t start) const
+{
+    if (start > nbytes())
+        return std::string::npos;
+    const uint8_t* end = bytes() + nbytes();
+    const uint8_t* found = simd_search(bytes() + start, end, needle.bytes(), needle.nbytes());
+    if (found == end && needle.nbytes() > 0)
+        return std::string::npos;
+    return found - bytes();
+}
+
+
+Object VM::Bytevector(const std::vector<uint8_t>& bytes)
+{
+    Object ret = Object::Bytevector(bytes.size());
+    std::memcpy(ret.bytes(), bytes.data(), bytes.size());
+    push(ret);
+    return ret;
+}
+
+void Op::bytevector(std::size_t nelems)
+{
+    Object vec = Object::Bytevector(nelems);
+    for (std::size_t i = 0; i < nelems; i++)
+        vec.bytes()[i] = (uint8_t)VM::peek(nelems - i - 1).fixnum();
+    VM::push(vec, nelems);
+}
+
+void Op::make_bytevector(std::size_t size, uint8_t fill)
+{
+    Object vec = Object::Bytevector(size);
+    vec.fill_bytes(fill, 0, size);
+    VM::push(vec);
+}
+
+void Op::bytevector_copy(std::size_t start, std::size_t end)
+{
+    Object vec = Object::Bytevector(end - start);
+    vec.copy_bytes(0, VM::peek(), start, end);
+    VM::push(vec, 1);
+}
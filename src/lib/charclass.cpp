@@ -0,0 +1,56 @@
+#include <cstring>
+
+#include "charclass.h"
+
+
+struct CharName {
+    const char* name;
+    char32_t c;
+};
+
+// Slots are given by name_hash(), which has no collisions between these
+// names, so a lookup is one hash and one comparison
+static const CharName char_names[16] = {
+    { nullptr, 0 },             // 0
+    { "escape", 0x1b },         // 1
+    { "return", 0x0d },         // 2
+    { nullptr, 0 },             // 3
+    { "delete", 0x7f },         // 4
+    { nullptr, 0 },             // 5
+    { nullptr, 0 },             // 6
+    { nullptr, 0 },             // 7
+    { "space", ' ' },           // 8
+    { "tab", '\t' },            // 9
+    { nullptr, 0 },             // 10
+    { nullptr, 0 },             // 11
+    { "null", 0 },              // 12
+    { "backspace", 0x08 },      // 13
+    { "alarm", 0x07 },          // 14
+    { "newline", '\n' },        // 15
+};
+
+static inline unsigned name_hash(std::string_view name)
+{
+    return ((unsigned char)name[0] + 2 * (unsigned char)name[1] + name.size()) & 15;
+}
+
+bool char_from_name(std::string_view name, char32_t& c)
+{
+    if (name.size() < 2)
+        return false;
+    const CharName& slot = char_names[name_hash(name)];
+    if (!slot.name || name != slot.name)
+        return false;
+    c = slot.c;
+    return true;
+}
+
+const char* char_name(char32_t c)
+{
+    if (c > ' ' && c != 0x7f)
+        return nullptr;
+    for (const CharName& slot : char_names)
+        if (slot.name && slot.c == c)
+            return slot.name;
+    return nullptr;
+}
@@ -0,0 +1,60 @@
+#include <array>
+#include <string_view>
+#include <stdint.h>
+
+
+#ifndef CHARCLASS_H
+#define CHARCLASS_H
+
+
+// Byte classes used by the lexer, as bits of a 256-entry table
+#define CHAR_SPACE      0x01    // Whitespace, as std::isspace in the C locale
+#define CHAR_DELIMITER  0x02    // Ends an identifier: whitespace, parentheses, brackets, quotes, ;
+#define CHAR_QUOTE      0x04    // Interrupts a string literal: double quote or backslash
+#define CHAR_INITIAL    0x08    // May start a symbol
+#define CHAR_SUBSEQUENT 0x10    // May continue a symbol
+#define CHAR_BLOCK      0x20    // May open or close a block comment: | or #
+#define CHAR_STRUCTURAL 0x40    // Matters for nesting: brackets, ", ; and #
+
+constexpr std::array<uint8_t, 256> make_char_classes()
+{
+    std::array<uint8_t, 256> table{};
+    for (int c = 0; c < 256; c++) {
+        // Bytes of multibyte UTF-8 sequences are all >= 0x80, and are
+        // treated as letters so that non-ASCII identifiers are accepted
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80)
+            table[c] |= CHAR_INITIAL | CHAR_SUBSEQUENT;
+        if (c == ' ' || (c >= '\t' && c <= '\r'))
+            table[c] |= CHAR_SPACE | CHAR_DELIMITER;
+    }
+    for (unsigned char c : "!$%&*/:<=>?~_^")
+        table[c] |= CHAR_INITIAL | CHAR_SUBSEQUENT;
+    for (unsigned char c : ".+-")
+        table[c] |= CHAR_SUBSEQUENT;
+    for (unsigned char c : "()[]\",`';")
+        table[c] |= CHAR_DELIMITER;
+    for (unsigned char c : "\"\\")
+        table[c] |= CHAR_QUOTE;
+    for (unsigned char c : "|#")
+        table[c] |= CHAR_BLOCK;
+    for (unsigned char c : "()[]\";#")
+        table[c] |= CHAR_STRUCTURAL;
+
+    // The string literals' terminating zeros
+    table[0] = 0;
+    return table;
+}
+
+constexpr std::array<uint8_t, 256> char_classes = make_char_classes();
+
+constexpr bool char_is(unsigned char c, uint8_t cls) { return char_classes[c] & cls; }
+
+
+// Named characters, as in #\space: look up the code point of a name,
+// returning false if there is no such name, and the name of a code point,
+// or nullptr if it is printed as itself
+bool char_from_name(std::string_view name, char32_t& c);
+const char* char_name(char32_t c);
+
+
+#endif /* CHARCLASS_H */
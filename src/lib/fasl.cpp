@@ -0,0 +1,494 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+
+#include "file.h"
+#include "gc.h"
+#include "numvector.h"
+#include "object.h"
+#include "vm.h"
+
+#include "fasl.h"
+
+
+#define REF_OBJECT 0x1
+#define REF_SYMBOL 0x9
+
+
+class FaslWriter
+{
+public:
+    bool collect(Object root);
+    void write(std::ostream& out, Object root);
+
+private:
+    template <typename T> inline void put(T value) {
+        buffer.append((const char*)&value, sizeof(T));
+    }
+    inline void put_bytes(const void* data, std::size_t n) {
+        put<uint64_t>(n);
+        buffer.append((const char*)data, n);
+    }
+    uint64_t ref(Object obj);
+    void put_record(Object obj);
+
+    std::string buffer;
+    std::unordered_map<uint64_t, uint64_t> index;
+    std::vector<Object> objects, symbols;
+};
+
+// Number every heap object reachable from root, iteratively, returning
+// false if any of them cannot be written
+bool FaslWriter::collect(Object root)
+{
+    std::vector<Object> pending;
+    pending.push_back(root);
+    while (!pending.empty()) {
+        Object obj = pending.back();
+        pending.pop_back();
+        if (obj.immediate() || index.count(obj.view()))
+            continue;
+
+        if (obj.type() == Type::Symbol) {
+            index[obj.view()] = symbols.size();
+            symbols.push_back(obj);
+            continue;
+        }
+        index[obj.view()] = objects.size();
+        objects.push_back(obj);
+
+        switch (obj.type()) {
+        case Type::Pair:
+            pending.push_back(obj.cdr());
+            pending.push_back(obj.car());
+            break;
+        case Type::Vector:
+            for (Object elt : obj)
+                pending.push_back(elt);
+            break;
+        case Type::Error:
+            pending.push_back(obj.signal());
+            pending.push_back(obj.payload());
+            break;
+        case Type::Table:
+            for (const TableSlot& slot : obj.table_slots())
+                if (slot.distance > 0) {
+                    pending.push_back(slot.key);
+                    pending.push_back(slot.value);
+                }
+            break;
+        case Type::RecordType:
+            pending.push_back(obj.record_fields());
+            pending.push_back(obj.record_name());
+            break;
+        case Type::Record:
+            for (std::size_t i = obj.nslots(); i > 0; i--)
+                pending.push_back(obj.slots()[i-1]);
+            pending.push_back(obj.record_type());
+            break;
+        case Type::String: case Type::Bytevector: case Type::NumVector:
+        case Type::Bignum: case Type::Flonum: case Type::StringBuilder:
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t FaslWriter::ref(Object obj)
+{
+    if (obj.immediate())
+        return obj.view();
+    return (index[obj.view()] << 4) | (obj.type() == Type::Symbol ? REF_SYMBOL : REF_OBJECT);
+}
+
+void FaslWriter::put_record(Object obj)
+{
+    put<uint8_t>((uint8_t)obj.type());
+    switch (obj.type()) {
+    case Type::Pair:
+        put(ref(obj.car()));
+        put(ref(obj.cdr()));
+        break;
+    case Type::Vector:
+        put<uint64_t>(obj.size());
+        for (Object elt : obj)
+            put(ref(elt));
+        break;
+    case Type::Error:
+        put(ref(obj.signal()));
+        put(ref(obj.payload()));
+        break;
+    case Type::String:
+        put_bytes(obj.text().data(), obj.text().size());
+        break;
+    case Type::Bytevector:
+        put_bytes(obj.bytes(), obj.nbytes());
+        break;
+    case Type::NumVector:
+        put<uint8_t>((uint8_t)obj.numeric());
+        put<uint64_t>(obj.length());
+        buffer.append(obj.elements<char>(), obj.length() * numeric_width(obj.numeric()));
+        break;
+    case Type::Bignum:
+        put<uint8_t>(obj.negative());
+        put_bytes(obj.limbs().data(), obj.limbs().size() * sizeof(uint32_t));
+        break;
+    case Type::Flonum:
+        put(obj.flonum());
+        break;
+    case Type::Table:
+        put<uint8_t>((uint8_t)obj.equivalence());
+        put<uint64_t>(obj.table_count());
+        for (const TableSlot& slot : obj.table_slots())
+            if (slot.distance > 0) {
+                put(ref(slot.key));
+                put(ref(slot.value));
+            }
+        break;
+    case Type::StringBuilder:
+        // Written flattened; the loaded builder shares nothing
+        put<uint64_t>(obj.builder_size());
+        obj.builder_pieces([&] (std::string_view piece) { buffer.append(piece); });
+        break;
+    case Type::RecordType:
+        put(ref(obj.record_name()));
+        put(ref(obj.record_fields()));
+        break;
+    case Type::Record:
+        put<uint64_t>(obj.nslots());
+        put(ref(obj.record_type()));
+        for (std::size_t i = 0; i < obj.nslots(); i++)
+            put(ref(obj.slots()[i]));
+        break;
+    default:
+        // collect() has rejected every other type
+        std::abort();
+    }
+}
+
+void FaslWriter::write(std::ostream& out, Object root)
+{
+    buffer.append(FASL_MAGIC);
+    put<uint32_t>(FASL_VERSION);
+
+    put<uint64_t>(symbols.size());
+    for (Object sym : symbols)
+        put_bytes(sym.text().data(), sym.text().size());
+
+    put<uint64_t>(objects.size());
+    for (Object obj : objects) {
+        put_record(obj);
+        if (buffer.size() >= 65536) {
+            out.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+
+    put(ref(root));
+    out.write(buffer.data(), buffer.size());
+    buffer.clear();
+}
+
+bool fasl_write(std::ostream& out, Object obj)
+{
+    FaslWriter writer;
+    if (!writer.collect(obj))
+        return false;
+    writer.write(out, obj);
+    return (bool)out;
+}
+
+bool fasl_write_file(const std::string& path, Object obj)
+{
+    std::ofstream out(path, std::ios::binary);
+    return fasl_write(out, obj) && out.flush();
+}
+
+
+// Bounds-checked reading from the input; on overrun it stops advancing
+// and clears ok, and reads return zeroes
+class FaslReader
+{
+public:
+    FaslReader(const char* data, std::size_t size) : pos(data), end(data + size), ok(true) { }
+
+    template <typename T> inline T get() {
+        T value = T();
+        if (ok && (std::size_t)(end - pos) >= sizeof(T)) {
+            std::memcpy(&value, pos, sizeof(T));
+            pos += sizeof(T);
+        }
+        else
+            ok = false;
+        return value;
+    }
+
+    // A count of items that each take at least one byte, so that it can
+    // be checked against the remaining input before anything is allocated
+    inline std::size_t get_count() {
+        uint64_t n = get<uint64_t>();
+        if (n > (uint64_t)(end - pos))
+            ok = false;
+        return ok ? n : 0;
+    }
+
+    inline const char* get_bytes(std::size_t n) {
+        if (!ok || (std::size_t)(end - pos) < n) {
+            ok = false;
+            return pos;
+        }
+        pos += n;
+        return pos - n;
+    }
+
+    const char* pos;
+    const char* end;
+    bool ok;
+};
+
+static void fasl_error(const std::string& msg)
+{
+    Op::intern("fasl");
+    Op::string(msg);
+    Op::error();
+    VM::push(Object::Undefined);
+}
+
+void Op::fasl_read(const char* data, std::size_t size)
+{
+    FaslReader in(data, size);
+    if (size < sizeof(FASL_MAGIC) - 1 || std::memcmp(data, FASL_MAGIC, sizeof(FASL_MAGIC) - 1) != 0) {
+        fasl_error("not a fasl file");
+        return;
+    }
+    in.get_bytes(sizeof(FASL_MAGIC) - 1);
+    if (in.get<uint32_t>() != FASL_VERSION) {
+        fasl_error("unsupported fasl version");
+        return;
+    }
+
+    // Nothing allocated here is reachable from a frame until the end
+    GC::inhibit();
+
+    std::vector<Object> symbols(in.get_count());
+    for (Object& sym : symbols) {
+        std::size_t len = in.get<uint64_t>();
+        const char* name = in.get_bytes(len);
+        if (!in.ok)
+            break;
+        sym = Object::Symbol(std::string_view(name, len));
+    }
+
+    // First pass: allocate every object, filling in everything that is
+    // not a reference, and remember where the rest of each record is
+    std::size_t nobjects = in.get_count();
+    std::vector<Object> objects;
+    std::vector<const char*> bodies;
+    objects.reserve(nobjects);
+    bodies.reserve(nobjects);
+
+    for (std::size_t i = 0; i < nobjects && in.ok; i++) {
+        Type type = (Type)in.get<uint8_t>();
+        bodies.push_back(in.pos);
+        Object obj;
+        switch (type) {
+        case Type::Pair:
+            in.get_bytes(2 * sizeof(uint64_t));
+            obj = Object::Pair(Object::Undefined, Object::Undefined);
+            break;
+        case Type::Error:
+            in.get_bytes(2 * sizeof(uint64_t));
+            obj = Object::Error(Object::Undefined, Object::Undefined);
+            break;
+        case Type::Vector: {
+            std::size_t n = in.get_count();
+            in.get_bytes(n * sizeof(uint64_t));
+            obj = Object::Vector(in.ok ? n : 0);
+            break;
+        }
+        case Type::String: {
+            std::size_t n = in.get<uint64_t>();
+            const char* bytes = in.get_bytes(n);
+            obj = Object::String(std::string_view(bytes, in.ok ? n : 0));
+            break;
+        }
+        case Type::Bytevector: {
+            std::size_t n = in.get<uint64_t>();
+            const char* bytes = in.get_bytes(n);
+            obj = Object::Bytevector(in.ok ? n : 0);
+            std::memcpy(obj.bytes(), bytes, obj.nbytes());
+            break;
+        }
+        case Type::NumVector: {
+            Numeric kind = (Numeric)in.get<uint8_t>();
+            std::size_t n = in.get_count();
+            if (kind == Numeric::U8 || kind > Numeric::F64) {
+                in.ok = false;
+                break;
+            }
+            const char* bytes = in.get_bytes(n * numeric_width(kind));
+            obj = Object::NumVector(kind, in.ok ? n : 0);
+            std::memcpy(obj.elements<char>(), bytes, obj.length() * numeric_width(kind));
+            break;
+        }
+        case Type::Bignum: {
+            // Only normalized bignums are ever written, so anything that
+            // has leading zero limbs or fits in a fixnum is corrupt
+            bool negative = in.get<uint8_t>();
+            std::size_t n = in.get<uint64_t>();
+            const char* bytes = in.get_bytes(n);
+            if (n % sizeof(uint32_t) != 0)
+                in.ok = false;
+            std::vector<uint32_t> limbs(in.ok ? n / sizeof(uint32_t) : 0);
+            std::memcpy(limbs.data(), bytes, limbs.size() * sizeof(uint32_t));
+            std::size_t nlimbs = limbs.size();
+            Op::integer(negative, std::move(limbs));
+            obj = VM::pop();
+            if (obj.type() != Type::Bignum || obj.limbs().size() != nlimbs)
+                in.ok = false;
+            break;
+        }
+        case Type::Flonum:
+            obj = Object::Flonum(in.get<double>());
+            break;
+        case Type::Table: {
+            Equivalence kind = (Equivalence)in.get<uint8_t>();
+            std::size_t n = in.get_count();
+            in.get_bytes(n * 2 * sizeof(uint64_t));
+            if (kind > Equivalence::String)
+                in.ok = false;
+            obj = Object::Table(kind);
+            break;
+        }
+        case Type::StringBuilder: {
+            std::size_t n = in.get<uint64_t>();
+            const char* bytes = in.get_bytes(n);
+            obj = Object::StringBuilder();
+            obj.builder_append(std::string_view(bytes, in.ok ? n : 0));
+            break;
+        }
+        case Type::RecordType:
+            in.get_bytes(2 * sizeof(uint64_t));
+            obj = Object::RecordType(Object::Undefined, Object::Undefined);
+            break;
+        case Type::Record: {
+            std::size_t n = in.get_count();
+            in.get_bytes((n + 1) * sizeof(uint64_t));
+            obj = Object::Record(Object::Undefined, in.ok ? n : 0);
+            break;
+        }
+        default:
+            in.ok = false;
+        }
+        objects.push_back(obj);
+    }
+    uint64_t root = in.get<uint64_t>();
+
+    bool valid = in.ok;
+    auto resolve = [&] (uint64_t ref) {
+        if ((ref & 0x7) != REF_OBJECT)
+            return Object(ref);
+        std::vector<Object>& table = (ref & 0xf) == REF_SYMBOL ? symbols : objects;
+        if ((ref >> 4) >= table.size()) {
+            valid = false;
+            return Object::Undefined;
+        }
+        return table[ref >> 4];
+    };
+
+    // Second pass: fill in references, now that every target exists.
+    // Tables go last, since hashing their keys may look inside them.
+    auto fill = [&] (bool tables) {
+        for (std::size_t i = 0; i < objects.size() && valid; i++) {
+            Object obj = objects[i];
+            if ((obj.type() == Type::Table) != tables)
+                continue;
+            FaslReader body(bodies[i], in.end - bodies[i]);
+            switch (obj.type()) {
+            case Type::Pair:
+                obj.set_car(resolve(body.get<uint64_t>()));
+                obj.set_cdr(resolve(body.get<uint64_t>()));
+                break;
+            case Type::Error:
+                obj.set_signal(resolve(body.get<uint64_t>()));
+                obj.set_payload(resolve(body.get<uint64_t>()));
+                break;
+            case Type::Vector:
+                body.get<uint64_t>();
+                for (std::size_t j = 0; j < obj.size(); j++)
+                    obj[j] = resolve(body.get<uint64_t>());
+                break;
+            case Type::RecordType:
+                obj.set_record_name(resolve(body.get<uint64_t>()));
+                obj.set_record_fields(resolve(body.get<uint64_t>()));
+                break;
+            case Type::Record:
+                body.get<uint64_t>();
+                obj.set_record_type(resolve(body.get<uint64_t>()));
+                for (std::size_t j = 0; j < obj.nslots(); j++)
+                    obj.slots()[j] = resolve(body.get<uint64_t>());
+                break;
+            case Type::Table: {
+                body.get<uint8_t>();
+                std::size_t n = body.get<uint64_t>();
+                for (std::size_t j = 0; j < n && valid; j++) {
+                    Object key = resolve(body.get<uint64_t>());
+                    if (obj.equivalence() == Equivalence::String && key.type() != Type::String)
+                        valid = false;
+                    else
+                        obj.table_set(key, resolve(body.get<uint64_t>()));
+                }
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    };
+    fill(false);
+
+    // Record types must name their fields with symbols, and instances
+    // must have a slot per field of their type
+    auto symbols_only = [] (Object fields) {
+        if (fields.type() != Type::Vector)
+            return false;
+        for (Object field : fields)
+            if (field.type() != Type::Symbol)
+                return false;
+        return true;
+    };
+    for (std::size_t i = 0; i < objects.size() && valid; i++) {
+        Object obj = objects[i];
+        if (obj.type() == Type::RecordType)
+            valid = obj.record_name().type() == Type::Symbol && symbols_only(obj.record_fields());
+        else if (obj.type() == Type::Record) {
+            Object rtd = obj.record_type();
+            valid = rtd.type() == Type::RecordType && symbols_only(rtd.record_fields()) &&
+                rtd.record_fields().size() == obj.nslots();
+        }
+    }
+
+    fill(true);
+
+    Object result = resolve(root);
+    GC::allow();
+
+    if (!valid)
+        fasl_error("malformed fasl data");
+    else
+        VM::push(result);
+}
+
+void Op::fasl_load(const std::string& path)
+{
+    MappedFile file(path);
+    if (!file) {
+        fasl_error("cannot open " + path);
+        return;
+    }
+    fasl_read(file.data(), file.size());
+}
@@ -0,0 +1,33 @@
+#include <ostream>
+#include <string>
+
+#include "object.h"
+
+
+#ifndef FASL_H
+#define FASL_H
+
+
+// Binary serialization of object graphs. The format is
+//
+//   magic "BRIMFASL", u32 version
+//   u64 symbol count, then per symbol: u64 length, name bytes
+//   u64 object count, then per object: u8 type, payload
+//   u64 root reference
+//
+// in native byte order. References are immediate objects written as they
+// are, or (index << 4) | 0x1 for objects and (index << 4) | 0x9 for
+// symbols. Every heap object is written once, so sharing and cycles
+// survive a round trip. Loading is done by Op::fasl_read and Op::fasl_load.
+//
+// Writing returns false, having written nothing, if obj reaches an object
+// that has no fasl representation.
+
+#define FASL_MAGIC "BRIMFASL"
+#define FASL_VERSION 1
+
+bool fasl_write(std::ostream& out, Object obj);
+bool fasl_write_file(const std::string& path, Object obj);
+
+
+#endif /* FASL_H */
@@ -0,0 +1,36 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "file.h"
+
+
+MappedFile::MappedFile(const std::string& path) : _data(nullptr), _size(0), mapped(false)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        _size = st.st_size;
+        if (_size == 0)
+            _data = "";
+        else {
+            void* addr = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                madvise(addr, _size, MADV_SEQUENTIAL);
+                _data = (const char*)addr;
+                mapped = true;
+            }
+        }
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (mapped)
+        munmap((void*)_data, _size);
+}
@@ -0,0 +1,30 @@
+#include <cstddef>
+#include <string>
+
+
+#ifndef FILE_H
+#define FILE_H
+
+
+// A read-only memory mapping of a whole file. Evaluates to false if the
+// file could not be opened or mapped.
+class MappedFile
+{
+public:
+    MappedFile(const std::string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    explicit operator bool() const { return _data != nullptr; }
+    inline const char* data() const { return _data; }
+    inline std::size_t size() const { return _size; }
+
+private:
+    const char* _data;
+    std::size_t _size;
+    bool mapped;
+};
+
+
+#endif /* FILE_H */
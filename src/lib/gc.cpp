@@ -1,22 +1,43 @@
 #include <algorithm>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 #include <stdlib.h>
 
+#include "pool.h"
 #include "vm.h"
 
 #include "gc.h"
 
 
 std::list<Object> GC::objects;
-std::size_t GC::limit = 1000;
+std::size_t GC::limit = GC_MIN_LIMIT;
 std::size_t GC::inhibitors = 0;
+__thread std::list<Object>* GC::heap = &GC::objects;
 
-static void mark(Object obj)
+// Marked substring views, whose parents are dealt with after marking
+static std::vector<Object> views;
+
+// Objects that are marked but whose fields are still to be traced. An
+// explicit stack rather than recursion, so that deeply nested data cannot
+// overflow the C++ stack.
+static std::vector<Object> gray;
+
+static inline void mark(Object obj)
 {
     if (obj.immediate() || obj.marked())
         return;
     obj.set_mark(true);
+    gray.push_back(obj);
+}
+
+static void trace(Object obj)
+{
     switch (obj.type()) {
+    case Type::String:
+        if (obj.string_parent().defined())
+            views.push_back(obj);
+        break;
     case Type::Pair:
         mark(obj.car());
         mark(obj.cdr());
@@ -27,17 +48,74 @@ static void mark(Object obj)
     case Type::Error:
         mark(obj.signal());
         mark(obj.payload());
+        break;
+    case Type::Table:
+        for (const TableSlot& slot : obj.table_slots())
+            if (slot.distance > 0) {
+                mark(slot.key);
+                mark(slot.value);
+            }
+        break;
+    case Type::RecordType:
+        mark(obj.record_name());
+        mark(obj.record_fields());
+        break;
+    case Type::Record:
+        mark(obj.record_type());
+        for (std::size_t i = 0; i < obj.nslots(); i++)
+            mark(obj.slots()[i]);
+        break;
+    case Type::StringBuilder:
+        for (const BuilderChunk& chunk : obj.builder_chunks())
+            mark(chunk.str);
+        break;
     default:
         break;
     }
 }
 
+static void mark_from(Object root)
+{
+    mark(root);
+    while (!gray.empty()) {
+        Object obj = gray.back();
+        gray.pop_back();
+        trace(obj);
+    }
+}
+
+// Keep the parents of live views alive, except those that are otherwise
+// unreachable and mostly unused; views of those get their own copies
+static void settle_views()
+{
+    std::unordered_map<uint64_t, std::size_t> covered;
+    for (Object view : views) {
+        Object parent = view.string_parent();
+        if (!parent.marked())
+            covered[parent.view()] += view.text().size();
+    }
+
+    for (Object view : views) {
+        Object parent = view.string_parent();
+        auto it = covered.find(parent.view());
+        if (it == covered.end())
+            continue;
+        if (it->second * SUBSTRING_KEEP_RATIO >= parent.text().size())
+            parent.set_mark(true);
+        else
+            view.unshare_string();
+    }
+    views.clear();
+}
+
 void GC::collect()
 {
     for (const Frame& frame : VM::frames())
         for (Object obj : frame.stack())
-            mark(obj);
-    mark(VM::get_error());
+            mark_from(obj);
+    mark_from(VM::get_error());
+    settle_views();
+    LiteralPool::sweep();
     objects.remove_if(
         [] (Object obj) {
             bool destroy = !obj.marked() && obj.type() != Type::Symbol;
@@ -48,4 +126,13 @@ void GC::collect()
     );
     for (Object obj : objects)
         obj.set_mark(false);
+
+    // Let the heap double before the next collection, so that large live
+    // heaps do not trigger a collection on every allocation
+    limit = std::max<std::size_t>(GC_MIN_LIMIT, 2 * objects.size());
+}
+
+void GC::use_heap(std::list<Object>* local)
+{
+    heap = local ? local : &objects;
 }
@@ -1,4 +1,5 @@
 #include <list>
+#include <new>
 #include <stdlib.h>
 
 #include "object.h"
@@ -8,6 +9,9 @@
 #define GC_H
 
 
+#define GC_MIN_LIMIT 1000
+
+
 class GC
 {
 private:
@@ -15,15 +19,21 @@ private:
     static std::size_t limit;
     static std::size_t inhibitors;
 
+    // Where the calling thread allocates: the collected heap, or a heap
+    // of a worker thread's own
+    static __thread std::list<Object>* heap __attribute__((tls_model("initial-exec")));
+
 public:
-    template <typename T> static Object alloc() {
-        if (objects.size() >= limit && inhibitors == 0)
+    // Types with inline storage pass the number of payload bytes to
+    // allocate directly after the struct
+    template <typename T> static Object alloc(std::size_t extra = 0) {
+        if (heap == &objects && objects.size() >= limit && inhibitors == 0)
             collect();
 
-        T* t = new T;
+        T* t = extra ? new (::operator new(sizeof(T) + extra)) T : new T;
         Object obj = Object(t);
         obj.set_mark(false);
-        objects.push_front(obj);
+        heap->push_front(obj);
         return obj;
     }
 
@@ -32,6 +42,12 @@ public:
     static inline std::size_t size() { return objects.size(); }
 
     static void collect();
+
+    // Worker threads allocate into heaps of their own, where nothing is
+    // collected, and which the collector only learns of once the thread
+    // that owns the VM adopts them. A null heap switches back.
+    static void use_heap(std::list<Object>* local);
+    static inline void adopt(std::list<Object>& local) { objects.splice(objects.begin(), local); }
 };
 
 
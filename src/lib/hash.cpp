@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "numvector.h"
+#include "object.h"
+
+#include "hash.h"
+
+
+static const uint64_t GOLDEN = 0x9e3779b97f4a7c15ULL;
+
+// Nodes visited by hash_equal before it stops descending, which keeps it
+// constant-time and terminating on cyclic structure
+static const std::size_t EQUAL_HASH_BUDGET = 64;
+
+// Compound nodes compared by equal before it starts tracking visited pairs
+// to detect cycles; most comparisons finish well within this
+static const std::size_t EQUAL_UNTRACKED_BUDGET = 1024;
+
+static inline uint64_t mix(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static inline uint64_t combine(uint64_t h, uint64_t x)
+{
+    return (h ^ mix(x)) * GOLDEN;
+}
+
+uint64_t hash_bytes(const void* data, std::size_t n)
+{
+    const char* pos = (const char*)data;
+    uint64_t h = GOLDEN ^ n;
+    for (; n >= 8; pos += 8, n -= 8) {
+        uint64_t word;
+        std::memcpy(&word, pos, 8);
+        h = combine(h, word);
+    }
+    if (n > 0) {
+        uint64_t word = 0;
+        std::memcpy(&word, pos, n);
+        h = combine(h, word);
+    }
+    return mix(h);
+}
+
+// The collector never moves objects, so address-based hashes stay valid
+// for the lifetime of the key and eq? tables never need rehashing
+uint64_t hash_eq(Object obj)
+{
+    return mix(obj.view());
+}
+
+uint64_t hash_eqv(Object obj)
+{
+    switch (obj.type()) {
+    case Type::Bignum: {
+        const std::vector<uint32_t>& limbs = obj.limbs();
+        return hash_bytes(limbs.data(), limbs.size() * sizeof(uint32_t)) ^ obj.negative();
+    }
+    case Type::Flonum: {
+        double value = obj.flonum();
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return mix(bits);
+    }
+    default:
+        return hash_eq(obj);
+    }
+}
+
+// Hash of an object that has no substructure to descend into
+static uint64_t hash_leaf(Object obj)
+{
+    switch (obj.type()) {
+    case Type::String:
+        return hash_bytes(obj.text().data(), obj.text().size());
+    case Type::Bytevector:
+        return hash_bytes(obj.bytes(), obj.nbytes());
+    case Type::NumVector:
+        return hash_bytes(obj.elements<char>(), obj.length() * numeric_width(obj.numeric()))
+            ^ (uint64_t)obj.numeric();
+    default:
+        return hash_eqv(obj);
+    }
+}
+
+// Combines the nodes of a preorder walk, so equal structures (cyclic or
+// not) produce the same sequence and thus the same hash
+uint64_t hash_equal(Object obj)
+{
+    std::vector<Object> stack;
+    stack.push_back(obj);
+    uint64_t h = GOLDEN;
+    std::size_t budget = EQUAL_HASH_BUDGET;
+
+    while (!stack.empty() && budget > 0) {
+        const Object x = stack.back();
+        stack.pop_back();
+        budget--;
+
+        switch (x.type()) {
+        case Type::Pair:
+            h = combine(h, (uint64_t)Type::Pair);
+            stack.push_back(x.cdr());
+            stack.push_back(x.car());
+            break;
+        case Type::Vector:
+            h = combine(h, x.size());
+            for (std::size_t i = std::min(x.size(), budget); i > 0; i--)
+                stack.push_back(x[i-1]);
+            break;
+        case Type::Error:
+            h = combine(h, (uint64_t)Type::Error);
+            stack.push_back(x.payload());
+            stack.push_back(x.signal());
+            break;
+        default:
+            h = combine(h, hash_leaf(x));
+        }
+    }
+    return mix(h);
+}
+
+bool eqv(Object a, Object b)
+{
+    if (a == b)
+        return true;
+    if (a.type() != b.type())
+        return false;
+
+    switch (a.type()) {
+    case Type::Bignum:
+        return a.negative() == b.negative() && a.limbs() == b.limbs();
+    case Type::Flonum: {
+        double x = a.flonum(), y = b.flonum();
+        return std::memcmp(&x, &y, sizeof(double)) == 0;
+    }
+    default:
+        return false;
+    }
+}
+
+// Union-find over compound objects, used once equal? has visited enough
+// nodes that the input might be cyclic. Two objects in the same class
+// have already been assumed equal, and need not be compared again.
+class EquivalenceClasses
+{
+public:
+    // Return whether a and b were already in the same class, and merge
+    // their classes either way
+    bool merge(Object a, Object b) {
+        uint64_t ra = find(a.view()), rb = find(b.view());
+        if (ra == rb)
+            return true;
+        parent[ra] = rb;
+        return false;
+    }
+
+private:
+    uint64_t find(uint64_t x) {
+        // Iterative, with path halving
+        for (auto it = parent.find(x); it != parent.end(); it = parent.find(x)) {
+            auto up = parent.find(it->second);
+            if (up != parent.end())
+                it->second = up->second;
+            x = it->second;
+        }
+        return x;
+    }
+
+    std::unordered_map<uint64_t, uint64_t> parent;
+};
+
+bool equal(Object a, Object b)
+{
+    std::vector<std::pair<Object, Object>> stack;
+    stack.emplace_back(a, b);
+    std::size_t budget = EQUAL_UNTRACKED_BUDGET;
+    EquivalenceClasses classes;
+
+    while (!stack.empty()) {
+        const Object x = stack.back().first, y = stack.back().second;
+        stack.pop_back();
+
+        if (eqv(x, y))
+            continue;
+        if (x.type() != y.type())
+            return false;
+
+        switch (x.type()) {
+        case Type::String:
+            if (x.text() != y.text())
+                return false;
+            continue;
+        case Type::Bytevector:
+            if (x.compare_bytes(y) != 0)
+                return false;
+            continue;
+        case Type::NumVector:
+            if (x.numeric() != y.numeric() || x.length() != y.length() ||
+                std::memcmp(x.elements<char>(), y.elements<char>(),
+                            x.length() * numeric_width(x.numeric())) != 0)
+                return false;
+            continue;
+        case Type::Pair: case Type::Vector: case Type::Error:
+            break;
+        default:
+            return false;
+        }
+
+        // Compound objects: past the budget, track which pairs of nodes
+        // are being compared so that cycles terminate
+        if (budget > 0)
+            budget--;
+        else if (classes.merge(x, y))
+            continue;
+
+        switch (x.type()) {
+        case Type::Pair:
+            stack.emplace_back(x.cdr(), y.cdr());
+            stack.emplace_back(x.car(), y.car());
+            break;
+        case Type::Error:
+            stack.emplace_back(x.payload(), y.payload());
+            stack.emplace_back(x.signal(), y.signal());
+            break;
+        default: {
+            std::size_t n = x.size();
+            if (n != y.size())
+                return false;
+            // Identical element words need no further comparison; check
+            // the whole payload at once and only descend into mismatches
+            if (n == 0)
+                break;
+            const Object* xs = &x[0];
+            const Object* ys = &y[0];
+            if (std::memcmp(xs, ys, n * sizeof(Object)) == 0)
+                break;
+            for (std::size_t i = n; i > 0; i--)
+                if (xs[i-1] != ys[i-1])
+                    stack.emplace_back(xs[i-1], ys[i-1]);
+        }
+        }
+    }
+    return true;
+}
+
+uint64_t hash(Equivalence kind, Object obj)
+{
+    switch (kind) {
+    case Equivalence::Eq: return hash_eq(obj);
+    case Equivalence::Eqv: return hash_eqv(obj);
+    case Equivalence::String: return hash_bytes(obj.text().data(), obj.text().size());
+    case Equivalence::Equal: break;
+    }
+    return hash_equal(obj);
+}
+
+bool equivalent(Equivalence kind, Object a, Object b)
+{
+    switch (kind) {
+    case Equivalence::Eq: return a == b;
+    case Equivalence::Eqv: return eqv(a, b);
+    case Equivalence::String: return a.text() == b.text();
+    case Equivalence::Equal: break;
+    }
+    return equal(a, b);
+}
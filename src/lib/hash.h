@@ -0,0 +1,25 @@
+#include <cstddef>
+#include <stdint.h>
+
+#include "object.h"
+
+
+#ifndef HASH_H
+#define HASH_H
+
+
+uint64_t hash_bytes(const void* data, std::size_t n);
+
+// Hashes consistent with eq?, eqv? and equal? respectively
+uint64_t hash_eq(Object obj);
+uint64_t hash_eqv(Object obj);
+uint64_t hash_equal(Object obj);
+
+bool eqv(Object a, Object b);
+bool equal(Object a, Object b);
+
+uint64_t hash(Equivalence kind, Object obj);
+bool equivalent(Equivalence kind, Object a, Object b);
+
+
+#endif /* HASH_H */
@@ -0,0 +1,444 @@
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+#include "object.h"
+#include "vm.h"
+
+#include "number.h"
+
+
+typedef std::vector<uint32_t> Limbs;
+
+// Operands at least this many limbs long are multiplied with Karatsuba
+static const std::size_t KARATSUBA_THRESHOLD = 32;
+
+
+static void trim(Limbs& a)
+{
+    while (!a.empty() && a.back() == 0)
+        a.pop_back();
+}
+
+static Limbs from_uint64(uint64_t mag)
+{
+    Limbs ret;
+    for (; mag > 0; mag >>= 32)
+        ret.push_back((uint32_t)mag);
+    return ret;
+}
+
+static Limbs magnitude(Object obj, bool& negative)
+{
+    if (obj.type() == Type::Bignum) {
+        negative = obj.negative();
+        return obj.limbs();
+    }
+    int64_t num = obj.fixnum();
+    negative = num < 0;
+    return from_uint64(negative ? -(uint64_t)num : (uint64_t)num);
+}
+
+static int compare(const Limbs& a, const Limbs& b)
+{
+    if (a.size() != b.size())
+        return a.size() < b.size() ? -1 : 1;
+    for (std::size_t i = a.size(); i > 0; i--)
+        if (a[i-1] != b[i-1])
+            return a[i-1] < b[i-1] ? -1 : 1;
+    return 0;
+}
+
+// acc += b * base^shift
+static void add_into(Limbs& acc, const Limbs& b, std::size_t shift = 0)
+{
+    if (acc.size() < b.size() + shift)
+        acc.resize(b.size() + shift, 0);
+    uint64_t carry = 0;
+    std::size_t i = 0;
+    for (; i < b.size(); i++) {
+        carry += (uint64_t)acc[i + shift] + b[i];
+        acc[i + shift] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    for (i += shift; carry && i < acc.size(); i++) {
+        carry += acc[i];
+        acc[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    if (carry)
+        acc.push_back((uint32_t)carry);
+}
+
+// acc -= b, requires acc >= b
+static void sub_into(Limbs& acc, const Limbs& b)
+{
+    int64_t borrow = 0;
+    for (std::size_t i = 0; i < acc.size(); i++) {
+        int64_t diff = (int64_t)acc[i] - (i < b.size() ? b[i] : 0) - borrow;
+        borrow = diff < 0;
+        acc[i] = (uint32_t)(diff + (borrow << 32));
+        if (i >= b.size() && !borrow)
+            break;
+    }
+    trim(acc);
+}
+
+static Limbs mul_schoolbook(const Limbs& a, const Limbs& b)
+{
+    Limbs ret(a.size() + b.size(), 0);
+    for (std::size_t i = 0; i < a.size(); i++) {
+        uint64_t carry = 0;
+        for (std::size_t j = 0; j < b.size(); j++) {
+            carry += (uint64_t)a[i] * b[j] + ret[i + j];
+            ret[i + j] = (uint32_t)carry;
+            carry >>= 32;
+        }
+        ret[i + b.size()] = (uint32_t)carry;
+    }
+    trim(ret);
+    return ret;
+}
+
+static Limbs mul_karatsuba(const Limbs& a, const Limbs& b)
+{
+    if (a.size() < KARATSUBA_THRESHOLD || b.size() < KARATSUBA_THRESHOLD)
+        return mul_schoolbook(a, b);
+
+    // Split both operands at m limbs: x = x1 * base^m + x0
+    std::size_t m = std::max(a.size(), b.size()) / 2;
+    auto low = [m] (const Limbs& x) {
+        Limbs ret(x.begin(), x.begin() + std::min(m, x.size()));
+        trim(ret);
+        return ret;
+    };
+    auto high = [m] (const Limbs& x) {
+        return x.size() > m ? Limbs(x.begin() + m, x.end()) : Limbs();
+    };
+    Limbs a0 = low(a), a1 = high(a), b0 = low(b), b1 = high(b);
+
+    Limbs z0 = mul_karatsuba(a0, b0);
+    Limbs z2 = mul_karatsuba(a1, b1);
+    add_into(a0, a1);
+    add_into(b0, b1);
+    Limbs z1 = mul_karatsuba(a0, b0);
+    sub_into(z1, z0);
+    sub_into(z1, z2);
+
+    Limbs ret = z0;
+    add_into(ret, z1, m);
+    add_into(ret, z2, 2*m);
+    trim(ret);
+    return ret;
+}
+
+// Divide in place by a single limb, returning the remainder
+static uint32_t divmod_small(Limbs& a, uint32_t d)
+{
+    uint64_t rem = 0;
+    for (std::size_t i = a.size(); i > 0; i--) {
+        uint64_t cur = (rem << 32) | a[i-1];
+        a[i-1] = (uint32_t)(cur / d);
+        rem = cur % d;
+    }
+    trim(a);
+    return (uint32_t)rem;
+}
+
+// Multiply in place by a single limb and add another
+static void muladd_small(Limbs& a, uint32_t m, uint32_t add)
+{
+    uint64_t carry = add;
+    for (uint32_t& limb : a) {
+        uint64_t cur = (uint64_t)limb * m + carry;
+        limb = (uint32_t)cur;
+        carry = cur >> 32;
+    }
+    if (carry)
+        a.push_back((uint32_t)carry);
+}
+
+// Push a + b where a and b are given in sign-magnitude form
+static void add_signed(bool na, Limbs&& a, bool nb, Limbs&& b)
+{
+    if (na == nb) {
+        add_into(a, b);
+        Op::integer(na, std::move(a));
+    }
+    else if (compare(a, b) >= 0) {
+        sub_into(a, b);
+        Op::integer(na, std::move(a));
+    }
+    else {
+        sub_into(b, a);
+        Op::integer(nb, std::move(b));
+    }
+}
+
+static bool check_integers(std::size_t nargs, const char* name)
+{
+    for (std::size_t i = 0; i < nargs; i++)
+        if (!VM::peek(i).integer()) {
+            Op::type_error(nargs, std::string(name) + ": expected integer");
+            return false;
+        }
+    return true;
+}
+
+
+std::string integer_to_string(Object obj, unsigned radix)
+{
+    static const char* digits = "0123456789abcdef";
+
+    bool negative;
+    Limbs mag = magnitude(obj, negative);
+    if (mag.empty())
+        return "0";
+
+    // Peel off as many digits as fit in one limb at a time
+    uint32_t chunk = radix;
+    unsigned chunk_digits = 1;
+    while ((uint64_t)chunk * radix <= UINT32_MAX) {
+        chunk *= radix;
+        chunk_digits++;
+    }
+
+    std::string ret;
+    while (!mag.empty()) {
+        uint32_t rem = divmod_small(mag, chunk);
+        for (unsigned i = 0; i < chunk_digits && (rem > 0 || !mag.empty()); i++) {
+            ret.push_back(digits[rem % radix]);
+            rem /= radix;
+        }
+    }
+    if (negative)
+        ret.push_back('-');
+    std::reverse(ret.begin(), ret.end());
+    return ret;
+}
+
+std::string flonum_to_string(double value)
+{
+    if (std::isnan(value))
+        return "+nan.0";
+    if (std::isinf(value))
+        return value < 0 ? "-inf.0" : "+inf.0";
+
+    // Shortest representation that reads back as the same double, marked
+    // as inexact if it would otherwise look like an integer
+    char buf[32];
+    std::string ret(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr);
+    if (ret.find_first_of(".e") == std::string::npos)
+        ret += ".0";
+    return ret;
+}
+
+static inline bool digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+bool parse_flonum(std::string_view text, double& value)
+{
+    bool negative = !text.empty() && text[0] == '-';
+    std::string_view digits = text;
+    if (!text.empty() && (text[0] == '-' || text[0] == '+'))
+        digits.remove_prefix(1);
+
+    if (digits.size() < text.size() && digits == "inf.0")
+        value = std::numeric_limits<double>::infinity();
+    else if (digits.size() < text.size() && digits == "nan.0")
+        value = std::numeric_limits<double>::quiet_NaN();
+    else {
+        // from_chars would also take inf and nan spelled other ways
+        if (digits.empty() || !(digit(digits[0]) ||
+                                (digits[0] == '.' && digits.size() > 1 && digit(digits[1]))))
+            return false;
+        const char* end = digits.data() + digits.size();
+        auto [ptr, ec] = std::from_chars(digits.data(), end, value);
+        if (ptr != end)
+            return false;
+
+        // Leave overflow to infinity and underflow to zero to strtod
+        if (ec == std::errc::result_out_of_range)
+            value = std::strtod(std::string(digits).c_str(), nullptr);
+    }
+    if (negative)
+        value = -value;
+    return true;
+}
+
+bool read_number(std::string_view text)
+{
+    unsigned radix = 10;
+    if (text.size() > 2 && text[0] == '#') {
+        switch (text[1]) {
+        case 'x': case 'X': radix = 16; break;
+        case 'o': case 'O': radix = 8; break;
+        case 'b': case 'B': radix = 2; break;
+        case 'd': case 'D': radix = 10; break;
+        default: return false;
+        }
+        text.remove_prefix(2);
+    }
+
+    bool negative = !text.empty() && text[0] == '-';
+    std::string_view digits = text;
+    if (!text.empty() && (text[0] == '-' || text[0] == '+'))
+        digits.remove_prefix(1);
+    if (digits.empty())
+        return false;
+
+    // Most integers fit in 64 bits, and fixnums need no allocation
+    const char* end = digits.data() + digits.size();
+    uint64_t mag;
+    auto [ptr, ec] = std::from_chars(digits.data(), end, mag, radix);
+    if (ptr == end && ec == std::errc()) {
+        if (mag <= (uint64_t)Object::FixnumMax)
+            VM::Integer(negative ? -(int64_t)mag : (int64_t)mag);
+        else
+            Op::integer(negative, from_uint64(mag));
+        return true;
+    }
+
+    // Longer ones, whose digits from_chars has checked, are read as many
+    // digits as fit in one limb at a time
+    if (ptr == end && ec == std::errc::result_out_of_range) {
+        Limbs limbs;
+        for (const char* pos = digits.data(); pos < end; ) {
+            uint32_t scale = 1, chunk = 0;
+            for (; pos < end && (uint64_t)scale * radix <= UINT32_MAX; pos++) {
+                unsigned c = (unsigned char)*pos;
+                chunk = chunk * radix + (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+                scale *= radix;
+            }
+            muladd_small(limbs, scale, chunk);
+        }
+        Op::integer(negative, std::move(limbs));
+        return true;
+    }
+
+    double value;
+    if (radix != 10 || !parse_flonum(text, value))
+        return false;
+    VM::Flonum(value);
+    return true;
+}
+
+
+Object VM::Integer(int64_t num)
+{
+    if (Object::fits_fixnum(num)) {
+        Object ret = Object::Fixnum(num);
+        push(ret);
+        return ret;
+    }
+    Object ret = Object::Bignum(num < 0, from_uint64(num < 0 ? -(uint64_t)num : (uint64_t)num));
+    push(ret);
+    return ret;
+}
+
+Object VM::Unsigned(uint64_t num)
+{
+    if (num <= (uint64_t)Object::FixnumMax)
+        return VM::Integer((int64_t)num);
+    Object ret = Object::Bignum(false, from_uint64(num));
+    push(ret);
+    return ret;
+}
+
+void Op::integer(bool negative, std::vector<uint32_t>&& magnitude)
+{
+    trim(magnitude);
+    if (magnitude.size() <= 2) {
+        uint64_t mag = magnitude.empty() ? 0 : magnitude[0];
+        if (magnitude.size() == 2)
+            mag |= (uint64_t)magnitude[1] << 32;
+        if (!negative && mag <= (uint64_t)Object::FixnumMax) {
+            VM::push(Object::Fixnum((int64_t)mag));
+            return;
+        }
+        if (negative && mag <= (uint64_t)Object::FixnumMax + 1) {
+            VM::push(Object::Fixnum(-(int64_t)(mag - 1) - 1));
+            return;
+        }
+    }
+    VM::push(Object::Bignum(negative, std::move(magnitude)));
+}
+
+void Op::add()
+{
+    // Fixnums are stored shifted left by one, so adding the raw words
+    // overflows exactly when the 63-bit sum does
+    Object a = VM::peek(1), b = VM::peek(0);
+    int64_t sum;
+    if (a.type() == Type::Fixnum && b.type() == Type::Fixnum &&
+        !__builtin_add_overflow((int64_t)a.data, (int64_t)b.data, &sum)) {
+        VM::push(Object((uint64_t)sum), 2);
+        return;
+    }
+
+    if (!check_integers(2, "+"))
+        return;
+    bool na, nb;
+    Limbs ma = magnitude(a, na), mb = magnitude(b, nb);
+    VM::pop(2);
+    add_signed(na, std::move(ma), nb, std::move(mb));
+}
+
+void Op::sub()
+{
+    Object a = VM::peek(1), b = VM::peek(0);
+    int64_t diff;
+    if (a.type() == Type::Fixnum && b.type() == Type::Fixnum &&
+        !__builtin_sub_overflow((int64_t)a.data, (int64_t)b.data, &diff)) {
+        VM::push(Object((uint64_t)diff), 2);
+        return;
+    }
+
+    if (!check_integers(2, "-"))
+        return;
+    bool na, nb;
+    Limbs ma = magnitude(a, na), mb = magnitude(b, nb);
+    VM::pop(2);
+    add_signed(na, std::move(ma), !nb && !mb.empty(), std::move(mb));
+}
+
+void Op::mul()
+{
+    // Multiplying a plain integer by a raw (doubled) fixnum gives the raw
+    // product, which overflows exactly when the 63-bit product does
+    Object a = VM::peek(1), b = VM::peek(0);
+    int64_t prod;
+    if (a.type() == Type::Fixnum && b.type() == Type::Fixnum &&
+        !__builtin_mul_overflow(a.fixnum(), (int64_t)b.data, &prod)) {
+        VM::push(Object((uint64_t)prod), 2);
+        return;
+    }
+
+    if (!check_integers(2, "*"))
+        return;
+    bool na, nb;
+    Limbs ma = magnitude(a, na), mb = magnitude(b, nb);
+    VM::pop(2);
+    Op::integer(na != nb, mul_karatsuba(ma, mb));
+}
+
+void Op::neg()
+{
+    Object a = VM::peek();
+    int64_t ret;
+    if (a.type() == Type::Fixnum && !__builtin_sub_overflow((int64_t)0, (int64_t)a.data, &ret)) {
+        VM::push(Object((uint64_t)ret), 1);
+        return;
+    }
+
+    if (!check_integers(1, "-"))
+        return;
+    bool na;
+    Limbs ma = magnitude(a, na);
+    VM::pop(1);
+    Op::integer(!na, std::move(ma));
+}
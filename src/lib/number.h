@@ -0,0 +1,26 @@
+#include <string>
+#include <string_view>
+
+#include "object.h"
+
+
+#ifndef NUMBER_H
+#define NUMBER_H
+
+
+// Render an integer (fixnum or bignum) in the given radix (2 to 16)
+std::string integer_to_string(Object obj, unsigned radix = 10);
+
+// Render a flonum so that it reads back as the same value
+std::string flonum_to_string(double value);
+
+// Parse a decimal flonum, including +inf.0, -inf.0 and +nan.0
+bool parse_flonum(std::string_view text, double& value);
+
+// Push the number written as text: an integer, optionally prefixed with
+// #x, #o, #b or #d, or a decimal flonum. Integers too long for 64 bits
+// become bignums. Returns false if text is not a number.
+bool read_number(std::string_view text);
+
+
+#endif /* NUMBER_H */
@@ -0,0 +1,237 @@
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include "number.h"
+#include "object.h"
+#include "vm.h"
+
+#include "numvector.h"
+
+
+static const char* tags[] = {
+    "u8", "s8", "u16", "s16", "u32", "s32", "u64", "s64", "f32", "f64"
+};
+
+const char* numeric_tag(Numeric kind)
+{
+    return tags[(int)kind];
+}
+
+std::size_t numeric_width(Numeric kind)
+{
+    return numeric_dispatch(kind, [] (auto elt) { return sizeof(elt); });
+}
+
+bool numeric_from_tag(std::string_view tag, Numeric& kind)
+{
+    for (int i = 0; i <= (int)Numeric::F64; i++)
+        if (tag == tags[i]) {
+            kind = (Numeric)i;
+            return true;
+        }
+    return false;
+}
+
+template <typename T> static bool store_integer(bool negative, uint64_t mag, void* dst)
+{
+    T value;
+    if (negative) {
+        if (!std::is_signed<T>::value || mag > (uint64_t)std::numeric_limits<T>::max() + 1)
+            return false;
+        value = (T)(-(int64_t)(mag - 1) - 1);
+    }
+    else {
+        if (mag > (uint64_t)std::numeric_limits<T>::max())
+            return false;
+        value = (T)mag;
+    }
+    std::memcpy(dst, &value, sizeof(T));
+    return true;
+}
+
+bool numeric_parse(Numeric kind, std::string_view text, void* dst)
+{
+    return numeric_dispatch(kind, [&] (auto elt) {
+        typedef decltype(elt) T;
+        if constexpr (std::is_integral<T>::value) {
+            const char* start = text.data();
+            const char* end = start + text.size();
+            bool negative = start < end && *start == '-';
+            if (start < end && (*start == '-' || *start == '+'))
+                start++;
+            uint64_t mag;
+            auto [ptr, ec] = std::from_chars(start, end, mag);
+            if (start == end || ptr != end || ec != std::errc())
+                return false;
+            return store_integer<T>(negative, mag, dst);
+        }
+        else {
+            double value;
+            if (!parse_flonum(text, value))
+                return false;
+            T stored = (T)value;
+            std::memcpy(dst, &stored, sizeof(T));
+            return true;
+        }
+    });
+}
+
+static bool store_object(Numeric kind, Object value, void* dst)
+{
+    return numeric_dispatch(kind, [&] (auto elt) {
+        typedef decltype(elt) T;
+        if constexpr (std::is_floating_point<T>::value) {
+            double num;
+            if (value.type() == Type::Flonum)
+                num = value.flonum();
+            else if (value.type() == Type::Fixnum)
+                num = (double)value.fixnum();
+            else
+                return false;
+            T stored = (T)num;
+            std::memcpy(dst, &stored, sizeof(T));
+            return true;
+        }
+        else {
+            bool negative;
+            uint64_t mag;
+            if (value.type() == Type::Fixnum) {
+                negative = value.fixnum() < 0;
+                mag = negative ? -(uint64_t)value.fixnum() : (uint64_t)value.fixnum();
+            }
+            else if (value.type() == Type::Bignum && value.limbs().size() <= 2) {
+                negative = value.negative();
+                mag = value.limbs()[0] | (uint64_t)value.limbs()[1] << 32;
+            }
+            else
+                return false;
+            return store_integer<T>(negative, mag, dst);
+        }
+    });
+}
+
+
+// A u8 vector is a bytevector, so every operation here takes either type
+static bool is_numvector(Object obj)
+{
+    return obj.type() == Type::NumVector || obj.type() == Type::Bytevector;
+}
+
+static Numeric numvector_kind(Object vec)
+{
+    return vec.type() == Type::Bytevector ? Numeric::U8 : vec.numeric();
+}
+
+static std::size_t numvector_length(Object vec)
+{
+    return vec.type() == Type::Bytevector ? vec.nbytes() : vec.length();
+}
+
+template <typename T> static T* numvector_data(Object vec)
+{
+    return vec.type() == Type::Bytevector ? reinterpret_cast<T*>(vec.bytes()) : vec.elements<T>();
+}
+
+
+// Element-wise kernels are plain loops over restrict-qualified arrays so
+// the compiler can vectorise them. Integer kinds wrap around, computing in
+// an unsigned type at least as wide as int to avoid undefined overflow.
+
+template <typename T, bool = std::is_integral<T>::value> struct Wrapping {
+    typedef std::make_unsigned_t<std::common_type_t<T, unsigned>> type;
+};
+template <typename T> struct Wrapping<T, false> { typedef T type; };
+
+template <typename T, typename Fn>
+static void kernel(T* __restrict out, const T* __restrict a, const T* __restrict b,
+                   std::size_t n, Fn fn)
+{
+    for (std::size_t i = 0; i < n; i++)
+        out[i] = fn(a[i], b[i]);
+}
+
+static void elementwise(char op)
+{
+    Object a = VM::peek(1), b = VM::peek(0);
+    CHECK_ARGS(is_numvector(a) && is_numvector(b) && numvector_kind(a) == numvector_kind(b) &&
+          numvector_length(a) == numvector_length(b),
+          2, type, std::string("numvector") + op + ": expected numeric vectors of equal type and length");
+
+    Numeric kind = numvector_kind(a);
+    std::size_t n = numvector_length(a);
+    Object ret = VM::NumVector(kind, nullptr, n);
+    numeric_dispatch(kind, [&] (auto elt) {
+        typedef decltype(elt) T;
+        typedef typename Wrapping<T>::type W;
+        T* out = numvector_data<T>(ret);
+        const T* x = numvector_data<T>(a);
+        const T* y = numvector_data<T>(b);
+        switch (op) {
+        case '+': kernel(out, x, y, n, [] (T p, T q) { return (T)((W)p + (W)q); }); break;
+        case '-': kernel(out, x, y, n, [] (T p, T q) { return (T)((W)p - (W)q); }); break;
+        case '*': kernel(out, x, y, n, [] (T p, T q) { return (T)((W)p * (W)q); }); break;
+        }
+    });
+    VM::pop(3);
+    VM::push(ret);
+}
+
+
+Object VM::Flonum(double value)
+{
+    Object ret = Object::Flonum(value);
+    push(ret);
+    return ret;
+}
+
+Object VM::NumVector(Numeric kind, const void* data, std::size_t nelems)
+{
+    std::size_t nbytes = nelems * numeric_width(kind);
+    Object ret = kind == Numeric::U8 ? Object::Bytevector(nelems) : Object::NumVector(kind, nelems);
+    void* dst = kind == Numeric::U8 ? (void*)ret.bytes() : (void*)ret.elements<char>();
+    if (data)
+        std::memcpy(dst, data, nbytes);
+    else
+        std::memset(dst, 0, nbytes);
+    push(ret);
+    return ret;
+}
+
+void Op::numvector_ref(std::size_t idx)
+{
+    Object vec = VM::peek();
+    CHECK_ARGS(is_numvector(vec), 1, type, "numvector-ref: not a numeric vector");
+    CHECK_ARGS(idx < numvector_length(vec), 1, range, "numvector-ref: index out of range");
+    VM::pop();
+    numeric_dispatch(numvector_kind(vec), [&] (auto elt) {
+        typedef decltype(elt) T;
+        T value = numvector_data<T>(vec)[idx];
+        if constexpr (std::is_floating_point<T>::value)
+            VM::Flonum(value);
+        else if constexpr (std::is_same<T, uint64_t>::value)
+            VM::Unsigned(value);
+        else
+            VM::Integer(value);
+    });
+}
+
+void Op::numvector_set(std::size_t idx)
+{
+    Object vec = VM::peek(1);
+    CHECK_ARGS(is_numvector(vec), 2, type, "numvector-set!: not a numeric vector");
+    CHECK_ARGS(idx < numvector_length(vec), 2, range, "numvector-set!: index out of range");
+    Numeric kind = numvector_kind(vec);
+    void* dst = numvector_data<char>(vec) + idx * numeric_width(kind);
+    if (!store_object(kind, VM::peek(), dst)) {
+        Op::type_error(2, std::string("numvector-set!: value out of range for ") + numeric_tag(kind));
+        return;
+    }
+    VM::pop();
+}
+
+void Op::numvector_add() { elementwise('+'); }
+void Op::numvector_sub() { elementwise('-'); }
+void Op::numvector_mul() { elementwise('*'); }
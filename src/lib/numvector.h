@@ -0,0 +1,39 @@
+#include <string>
+#include <string_view>
+
+#include "object.h"
+
+
+#ifndef NUMVECTOR_H
+#define NUMVECTOR_H
+
+
+// SRFI-4 tag ("u8", "s16", "f64", ...) and element width of each kind
+const char* numeric_tag(Numeric kind);
+std::size_t numeric_width(Numeric kind);
+bool numeric_from_tag(std::string_view tag, Numeric& kind);
+
+// Parse a literal element of the given kind into dst, returning false if
+// it is malformed or out of range
+bool numeric_parse(Numeric kind, std::string_view text, void* dst);
+
+// Call f with a value of the C++ element type of the given kind
+template <typename F> inline auto numeric_dispatch(Numeric kind, F f)
+{
+    switch (kind) {
+    case Numeric::U8: return f(uint8_t());
+    case Numeric::S8: return f(int8_t());
+    case Numeric::U16: return f(uint16_t());
+    case Numeric::S16: return f(int16_t());
+    case Numeric::U32: return f(uint32_t());
+    case Numeric::S32: return f(int32_t());
+    case Numeric::U64: return f(uint64_t());
+    case Numeric::S64: return f(int64_t());
+    case Numeric::F32: return f(float());
+    case Numeric::F64: break;
+    }
+    return f(double());
+}
+
+
+#endif /* NUMVECTOR_H */
@@ -1,16 +1,25 @@
+#include <cstring>
+
 #include "gc.h"
+#include "numvector.h"
+#include "utf8.h"
 
 #include "object.h"
 
 
-std::map<std::string, Object> Object::symtable;
+std::map<std::string, Object, std::less<>> Object::symtable;
 Object Object::False = Object(__FALSE);
 Object Object::True = Object(__TRUE);
 Object Object::EmptyList = Object(__EMPTYLIST);
 Object Object::Undefined = Object(__UNDEFINED);
+Object Object::EmptyString = Object(__EMPTYSTRING);
+Object Object::EmptyVector = Object(__EMPTYVECTOR);
+const std::vector<Object> Object::no_elements;
+const int64_t Object::FixnumMin;
+const int64_t Object::FixnumMax;
 
 
-Object Object::Symbol(const std::string& name)
+Object Object::Symbol(std::string_view name)
 {
     auto it = symtable.find(name);
     if (it != symtable.end())
@@ -19,18 +28,98 @@ Object Object::Symbol(const std::string& name)
     Object obj = GC::alloc<Symbol_>();
     obj.set_type(Type::Symbol);
     obj.set_string(name);
-    symtable[name] = obj;
+    symtable.emplace(name, obj);
     return obj;
 }
 
-Object Object::String(const std::string& data)
+Object Object::String(std::string_view data)
 {
+    if (data.size() <= SMALL_STRING_MAX) {
+        Object obj(__EMPTYSTRING | (data.size() << 5));
+        std::memcpy(reinterpret_cast<char*>(&obj.data) + 1, data.data(), data.size());
+        return obj;
+    }
+
     Object obj = GC::alloc<String_>();
     obj.set_type(Type::String);
     obj.set_string(data);
+
+    std::size_t length = 0;
+    bool ascii = true;
+    for (char c : data) {
+        ascii &= (unsigned char)c < 0x80;
+        length += !utf8_continuation(c);
+    }
+    obj.deref<String_>()->length = length;
+    obj.deref<String_>()->ascii = ascii;
+    return obj;
+}
+
+// A view of bytes [start, end) of parent, holding length code points
+Object Object::Substring(Object parent, std::size_t start, std::size_t end, std::size_t length)
+{
+    Object obj = GC::alloc<String_>();
+    obj.set_type(Type::String);
+    String_* str = obj.deref<String_>();
+    str->text = parent.text().substr(start, end - start);
+    str->parent = parent;
+    str->length = length;
+    str->ascii = parent.ascii() || length == end - start;
     return obj;
 }
 
+// Give a view its own copy of its bytes, detaching it from the parent
+void Object::unshare_string()
+{
+    String_* str = deref<String_>();
+    str->data.assign(str->text);
+    str->text = str->data;
+    str->parent = Object::Undefined;
+}
+
+// Byte offset of the code point at idx, which may be the length
+std::size_t Object::string_offset(std::size_t idx) const
+{
+    if (small_string()) {
+        std::string_view text = this->text();
+        std::size_t offset = 0;
+        for (; idx > 0; idx--)
+            while (++offset < text.size() && utf8_continuation(text[offset])) ;
+        return offset;
+    }
+
+    String_* str = deref<String_>();
+    if (str->ascii || idx == str->length)
+        return str->ascii ? idx : str->text.size();
+
+    std::string_view text = str->text;
+    if (str->breadcrumbs.empty()) {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < text.size(); i++) {
+            if (utf8_continuation(text[i]))
+                continue;
+            if (count % STRING_STRIDE == 0)
+                str->breadcrumbs.push_back(i);
+            count++;
+        }
+    }
+
+    const char* pos = text.data() + str->breadcrumbs[idx / STRING_STRIDE];
+    const char* end = text.data() + text.size();
+    for (std::size_t i = idx % STRING_STRIDE; i > 0; i--)
+        utf8_decode(pos, end);
+    return pos - text.data();
+}
+
+char32_t Object::string_ref(std::size_t idx) const
+{
+    std::string_view text = this->text();
+    if (ascii())
+        return (unsigned char)text[idx];
+    const char* pos = text.data() + string_offset(idx);
+    return utf8_decode(pos, text.data() + text.size());
+}
+
 Object Object::Pair(Object car, Object cdr)
 {
     Object obj = GC::alloc<Pair_>();
@@ -42,12 +131,39 @@ Object Object::Pair(Object car, Object cdr)
 
 Object Object::Vector(uint64_t size)
 {
+    if (size == 0)
+        return EmptyVector;
     Object obj = GC::alloc<Vector_>();
     obj.set_type(Type::Vector);
     obj.set_size(size);
     return obj;
 }
 
+Object Object::Bytevector(std::size_t size)
+{
+    Object obj = GC::alloc<Bytevector_>(size);
+    obj.set_type(Type::Bytevector);
+    obj.deref<Bytevector_>()->size = size;
+    return obj;
+}
+
+Object Object::Flonum(double value)
+{
+    Object obj = GC::alloc<Flonum_>();
+    obj.set_type(Type::Flonum);
+    obj.deref<Flonum_>()->value = value;
+    return obj;
+}
+
+Object Object::NumVector(Numeric kind, std::size_t size)
+{
+    Object obj = GC::alloc<NumVector_>(size * numeric_width(kind));
+    obj.set_type(Type::NumVector);
+    obj.deref<NumVector_>()->kind = kind;
+    obj.deref<NumVector_>()->size = size;
+    return obj;
+}
+
 Object Object::Error(Object signal, Object payload)
 {
     Object obj = GC::alloc<Error_>();
@@ -57,12 +173,27 @@ Object Object::Error(Object signal, Object payload)
     return obj;
 }
 
+Object Object::Bignum(bool negative, std::vector<uint32_t>&& limbs)
+{
+    Object obj = GC::alloc<Bignum_>();
+    obj.set_type(Type::Bignum);
+    obj.deref<Bignum_>()->negative = negative;
+    obj.deref<Bignum_>()->limbs = std::move(limbs);
+    return obj;
+}
+
 Type Object::type() const
 {
     switch (data & 0x7) {
     case 0x0: case 0x2: case 0x4: case 0x6: return Type::Fixnum;
     case 0x1: return deref<Header>()->type;
-    case 0x3: return Type::Character;
+    case 0x3:
+        switch (data & 0x1f) {
+        case 0x03: return Type::Character;
+        case __EMPTYSTRING: return Type::String;
+        case __EMPTYVECTOR: return Type::Vector;
+        }
+        break;
     case 0x5: return data == __FALSE ? Type::False : Type::True;
     }
 
@@ -73,61 +204,6 @@ Type Object::type() const
     return Type::Undefined;
 }
 
-std::ostream& operator<<(std::ostream& out, Object obj)
-{
-    switch (obj.type()) {
-    case Type::Fixnum: out << obj.fixnum(); break;
-    case Type::Character: out << "#\\" << obj.character(); break;
-    case Type::False: out << "#f"; break;
-    case Type::True: out << "#t"; break;
-    case Type::EmptyList: out << "()"; break;
-    case Type::Undefined: out << "#<undefined>"; break;
-    case Type::Symbol: out << obj.string(); break;
-    case Type::Error: out << "#<error " << obj.signal() << " " << obj.payload() << ">"; break;
-    case Type::String: {
-        out << '"';
-        for (char c : obj.string()) {
-            switch (c) {
-            case '\n': out << "\\n"; break;
-            case '\t': out << "\\t"; break;
-            case '\\': case '"':
-                out << '\\' << c; break;
-            default: out << c;
-            }
-        }
-        out << '"';
-        break;
-    }
-    case Type::Vector: {
-        out << "#(";
-        bool first = true;
-        for (Object elt : obj) {
-            if (!first) out << " ";
-            out << elt;
-            first = false;
-        }
-        out << ")";
-        break;
-    }
-    case Type::Pair: {
-        out << "(";
-        bool first = true;
-        FOR_LIST(obj, elt, tail)
-        {
-            if (!first) out << " ";
-            out << elt;
-            first = false;
-        }
-        if (tail != Object::EmptyList)
-            out << " . " << tail;
-        out << ")";
-        break;
-    }
-    }
-
-    return out;
-}
-
 bool Object::proper_list(std::size_t nitems) const {
     return proper_list(nitems, nitems);
 }
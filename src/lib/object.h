@@ -1,9 +1,14 @@
+#include <cassert>
 #include <map>
+#include <new>
 #include <ostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <stdint.h>
 
+#include "utf8.h"
+
 
 #ifndef OBJECT_H
 #define OBJECT_H
@@ -12,6 +17,23 @@
 #define __TRUE 0xd
 #define __EMPTYLIST 0x7
 #define __UNDEFINED 0xf
+#define __EMPTYSTRING 0xb
+#define __EMPTYVECTOR 0x13
+
+// The accessors below do no checking, and must only be used on objects
+// of the right type (see the checked operations in vm.h). Debug builds
+// assert this.
+#ifdef DEBUG
+#define OBJECT_CHECK(cond) assert(cond)
+#else
+#define OBJECT_CHECK(cond)
+#endif
+
+// Strings of up to seven bytes are immediate: the low byte holds the tag
+// and the length, and the bytes follow in memory (on little-endian hosts)
+#define SMALL_STRING_MAX 7
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "immediate strings assume a little-endian host");
 
 #define DECONS(pre,post) inline Object c##post##pre##r() const { return c##pre##r().c##post##r(); }
 #define DECONSES(pre) DECONS(pre,a) DECONS(pre,d)
@@ -24,19 +46,36 @@
 
 enum class Type {
     Fixnum,                     //     0
-    Character,                  //   011
+    Character,                  // 00000011
+                                // LLL01011 (immediate strings)
+                                // 00010011 (empty vector)
     False,                      //  0101
     True,                       //  1101
 
     EmptyList,                  // 00111
     Undefined,                  // 01111
 
-    Symbol, String, Pair, Vector, Error
+    Symbol, String, Pair, Vector, Error, Bignum, Bytevector,
+    Flonum, NumVector, Table, RecordType, Record, StringBuilder
+};
+
+// Element types of homogeneous numeric vectors (u8 vectors are bytevectors)
+enum class Numeric : uint8_t {
+    U8, S8, U16, S16, U32, S32, U64, S64, F32, F64
+};
+
+// Key equivalence of hash tables; String tables only hold string keys
+enum class Equivalence : uint8_t {
+    Eq, Eqv, Equal, String
 };
 
+struct TableSlot;
+struct BuilderChunk;
+
 struct Header {
     Type type;
-    bool mark;
+    bool mark = false;
+    bool immutable = false;
 };
 
 class Object
@@ -45,25 +84,45 @@ class Object
     friend class Op;
 
 private:
-    static std::map<std::string, Object> symtable;
+    static std::map<std::string, Object, std::less<>> symtable;
 
-    static Object Fixnum(int64_t num) { return Object(2*num); }
-    static Object Character(char c) { return Object((c << 3) | 0x3); }
-    static Object String(const std::string& data);
+    // Raw fixnum constructor: the caller guarantees that num fits in 63 bits
+    static Object Fixnum(int64_t num) { return Object((uint64_t)num << 1); }
+    static Object Character(char32_t c) { return Object(((uint64_t)c << 8) | 0x3); }
+    static Object String(std::string_view data);
+    static Object Substring(Object parent, std::size_t start, std::size_t end, std::size_t length);
     static Object Pair(Object car, Object cdr);
     static Object Vector(uint64_t n);
     static Object Error(Object signal, Object payload);
-    static Object Symbol(const std::string& name);
+    static Object Symbol(std::string_view name);
+    static Object Bignum(bool negative, std::vector<uint32_t>&& limbs);
+    static Object Bytevector(std::size_t size);
+    static Object Flonum(double value);
+    static Object NumVector(Numeric kind, std::size_t size);
+    static Object Table(Equivalence kind);
+    static Object RecordType(Object name, Object fields);
+    static Object Record(Object rtd);
+    static Object Record(Object rtd, std::size_t nslots);
+    static Object StringBuilder();
 
 public:
-    static Object False, True, EmptyList, Undefined;
+    static Object False, True, EmptyList, Undefined, EmptyString, EmptyVector;
+
+    static const int64_t FixnumMin = -((int64_t)1 << 62);
+    static const int64_t FixnumMax = ((int64_t)1 << 62) - 1;
+    static inline bool fits_fixnum(int64_t num) { return num >= FixnumMin && num <= FixnumMax; }
 
 private:
     uint64_t data;
 
+    // Elements of the immediate empty vector
+    static const std::vector<Object> no_elements;
+
+    inline bool small_string() const { return (data & 0x1f) == __EMPTYSTRING; }
+
     template <typename T> inline T* deref() const;
 
-    inline void set_string(std::string data);
+    inline void set_string(std::string_view data);
 
 public:
     Object() : data(__UNDEFINED) { }
@@ -72,7 +131,7 @@ public:
 
     inline void destroy();
 
-    uint64_t view() { return data; }
+    uint64_t view() const { return data; }
 
     Type type() const;
     inline void set_type(Type type);
@@ -80,9 +139,60 @@ public:
     inline bool undefined() const { return data == __UNDEFINED; }
 
     inline int64_t fixnum() const { return ((int64_t)data) / 2; }
-    inline char character() const { return (char)(data >> 3); }
+    inline char32_t character() const { return (char32_t)(data >> 8); }
 
     inline const std::string string() const;
+    // The text of an immediate string lives in the Object itself, so the
+    // view points into this variable and must not outlive it; call text()
+    // on a named Object rather than a temporary
+    inline std::string_view text() const;
+    inline std::size_t string_length() const;
+    inline bool ascii() const;
+    char32_t string_ref(std::size_t idx) const;
+    std::size_t string_offset(std::size_t idx) const;
+    inline Object string_parent() const;
+    void unshare_string();
+
+    inline uint8_t* bytes() const;
+    inline std::size_t nbytes() const;
+    void fill_bytes(uint8_t value, std::size_t start, std::size_t end);
+    void copy_bytes(std::size_t at, Object from, std::size_t start, std::size_t end);
+    int compare_bytes(Object other) const;
+    std::size_t search_bytes(Object needle, std::size_t start = 0) const;
+
+    inline double flonum() const;
+
+    inline Numeric numeric() const;
+    inline std::size_t length() const;
+    template <typename T> inline T* elements() const;
+
+    inline bool negative() const;
+    inline const std::vector<uint32_t>& limbs() const;
+
+    inline Equivalence equivalence() const;
+    inline std::size_t table_count() const;
+    inline const std::vector<TableSlot>& table_slots() const;
+    // Keys of string tables must be strings; other keys are never found,
+    // and must not be stored
+    Object table_ref(Object key, Object fallback = Object::Undefined) const;
+    void table_set(Object key, Object value);
+    bool table_delete(Object key);
+
+    inline Object record_name() const;
+    inline Object record_fields() const;
+    std::size_t field_index(Object name) const;
+    inline Object record_type() const;
+    inline void set_record_name(Object name);
+    inline void set_record_fields(Object fields);
+    inline void set_record_type(Object rtd);
+    inline std::size_t nslots() const;
+    inline Object* slots() const;
+
+    inline std::size_t builder_size() const;
+    inline const std::vector<BuilderChunk>& builder_chunks() const;
+    void builder_append(Object str);
+    void builder_append(std::string_view text);
+    template <typename F> inline void builder_pieces(F f) const;
 
     inline Object car() const;
     inline Object cdr() const;
@@ -94,6 +204,8 @@ public:
 
     inline std::size_t size() const;
     inline void set_size(std::size_t size);
+    // set_car, set_cdr and the non-const operator[] assert that the object
+    // is mutable, so read pooled vectors through a const Object
     inline Object& operator[](std::size_t idx);
     inline const Object& operator[](std::size_t idx) const;
 
@@ -108,14 +220,17 @@ public:
     inline friend bool operator==(const Object lhs, const Object rhs);
     inline friend bool operator!=(const Object lhs, const Object rhs);
 
-    inline bool immediate() const {
+    inline bool integer() const {
         Type tp = type();
-        return tp == Type::Fixnum || tp == Type::Character || tp == Type::False ||
-               tp == Type::True || tp == Type::EmptyList || tp == Type::Undefined;
+        return tp == Type::Fixnum || tp == Type::Bignum;
     }
 
+    inline bool immediate() const { return (data & 0x7) != 0x1; }
+
     inline bool marked() const { return deref<Header>()->mark; }
     inline void set_mark(bool mark) { deref<Header>()->mark = mark; }
+    inline bool immutable() const { return immediate() || deref<Header>()->immutable; }
+    inline void set_immutable(bool immutable) { deref<Header>()->immutable = immutable; }
 
     bool proper_list(std::size_t nitems) const;
     bool proper_list(std::size_t min_items, std::size_t max_items) const;
@@ -124,14 +239,35 @@ public:
     Object nth(std::size_t index) const;
 };
 
+// Symbols and strings begin with the same members, so that text() and
+// set_string() work on both
 struct Symbol_ {
     Header hdr;
+    std::string_view text;
     std::string name;
 };
 
+// Strings hold UTF-8. Indexing by code point goes straight to the byte
+// for ASCII-only strings; otherwise it starts from a breadcrumb (the byte
+// offset of every STRING_STRIDE-th code point, built on first use).
+#define STRING_STRIDE 32
+
+// Substrings of at least SUBSTRING_SHARE_MIN bytes are views into the
+// parent's data rather than copies. A parent that is reachable only
+// through views is kept alive by the GC as long as they cover at least
+// 1/SUBSTRING_KEEP_RATIO of it; otherwise the views get copies of their
+// own and the parent is freed.
+#define SUBSTRING_SHARE_MIN 16
+#define SUBSTRING_KEEP_RATIO 4
+
 struct String_ {
     Header hdr;
+    std::string_view text;      // Into data, or into the parent's data
     std::string data;
+    Object parent;              // Undefined unless this is a view
+    std::size_t length;
+    bool ascii;
+    std::vector<std::size_t> breadcrumbs;
 };
 
 struct Pair_ {
@@ -151,39 +287,223 @@ struct Error_ {
     Object payload;
 };
 
+// Raw bytes, stored inline directly after the struct
+struct Bytevector_ {
+    Header hdr;
+    std::size_t size;
+
+    inline uint8_t* data() { return reinterpret_cast<uint8_t*>(this + 1); }
+};
+
+// Homogeneous numeric vectors, with elements stored inline after the struct
+struct NumVector_ {
+    Header hdr;
+    Numeric kind;
+    std::size_t size;
+
+    inline void* data() { return reinterpret_cast<void*>(this + 1); }
+};
+
+// Hash tables use open addressing with Robin Hood probing. Each slot
+// caches its key's hash and its distance from the home slot plus one, so
+// that a distance of zero marks an empty slot.
+struct TableSlot {
+    Object key;
+    Object value;
+    uint32_t hash;
+    uint32_t distance;
+};
+
+struct Table_ {
+    Header hdr;
+    Equivalence kind;
+    std::size_t count;
+    std::vector<TableSlot> slots;
+};
+
+// Record type descriptors. Field names are kept in a vector of symbols,
+// and field i of every instance lives in slot i.
+struct RecordType_ {
+    Header hdr;
+    Object name;
+    Object fields;
+};
+
+// Record instances, with slots stored inline after the struct
+struct Record_ {
+    Header hdr;
+    Object rtd;
+    std::size_t nslots;
+
+    inline Object* slots() { return reinterpret_cast<Object*>(this + 1); }
+};
+
+// String builders append in amortised constant time and are flattened
+// on demand. Short appends are copied into one buffer, while longer
+// strings are shared; each shared chunk sits just before byte 'at' of
+// the buffer, so the contents are small[0, at_0) chunk_0 small[at_0,
+// at_1) chunk_1 and so on, up to the end of small.
+#define BUILDER_SHARE_SIZE 64
+
+struct BuilderChunk {
+    Object str;
+    std::size_t at;
+};
+
+struct StringBuilder_ {
+    Header hdr;
+    std::vector<BuilderChunk> chunks;
+    std::string small;
+    std::size_t size;
+};
+
+struct Flonum_ {
+    Header hdr;
+    double value;
+};
+
+// Integers outside the fixnum range, stored as sign and magnitude with
+// little-endian 32-bit limbs. Never holds a value that fits in a fixnum.
+struct Bignum_ {
+    Header hdr;
+    bool negative;
+    std::vector<uint32_t> limbs;
+};
+
 inline void Object::destroy() {
     switch(type()) {
     case Type::Symbol: delete deref<Symbol_>(); break;
     case Type::String: delete deref<String_>(); break;
     case Type::Pair: delete deref<Pair_>(); break;
     case Type::Vector: delete deref<Vector_>(); break;
+    case Type::Error: delete deref<Error_>(); break;
+    case Type::Bignum: delete deref<Bignum_>(); break;
+    case Type::Bytevector: ::operator delete(deref<Bytevector_>()); break;
+    case Type::NumVector: ::operator delete(deref<NumVector_>()); break;
+    case Type::Flonum: delete deref<Flonum_>(); break;
+    case Type::Table: delete deref<Table_>(); break;
+    case Type::RecordType: delete deref<RecordType_>(); break;
+    case Type::Record: ::operator delete(deref<Record_>()); break;
+    case Type::StringBuilder: delete deref<StringBuilder_>(); break;
     default: break;
     }
 }
 
-template <typename T> inline T* Object::deref() const { return (T*)(data - 1); }
+template <typename T> inline T* Object::deref() const {
+    OBJECT_CHECK((data & 0x7) == 0x1);
+    return (T*)(data - 1);
+}
 inline void Object::set_type(Type type) { deref<Header>()->type = type; }
 
-inline const std::string Object::string() const { return deref<String_>()->data; }
-inline void Object::set_string(std::string name) { deref<String_>()->data = name; }
+inline const std::string Object::string() const { return std::string(text()); }
+inline std::string_view Object::text() const {
+    if (small_string())
+        return std::string_view(reinterpret_cast<const char*>(&data) + 1, (data >> 5) & 0x7);
+    return deref<String_>()->text;
+}
+inline void Object::set_string(std::string_view name) {
+    String_* str = deref<String_>();
+    str->data.assign(name);
+    str->text = str->data;
+}
+inline Object Object::string_parent() const {
+    return small_string() ? Object::Undefined : deref<String_>()->parent;
+}
+inline std::size_t Object::string_length() const {
+    if (!small_string())
+        return deref<String_>()->length;
+    std::size_t length = 0;
+    for (char c : text())
+        length += !utf8_continuation(c);
+    return length;
+}
+inline bool Object::ascii() const {
+    return small_string() ? ((data >> 8) & 0x0080808080808080) == 0 : deref<String_>()->ascii;
+}
+
+inline uint8_t* Object::bytes() const { return deref<Bytevector_>()->data(); }
+inline std::size_t Object::nbytes() const { return deref<Bytevector_>()->size; }
+
+inline double Object::flonum() const { return deref<Flonum_>()->value; }
+
+inline Numeric Object::numeric() const { return deref<NumVector_>()->kind; }
+inline std::size_t Object::length() const { return deref<NumVector_>()->size; }
+template <typename T> inline T* Object::elements() const {
+    return reinterpret_cast<T*>(deref<NumVector_>()->data());
+}
+
+inline bool Object::negative() const { return deref<Bignum_>()->negative; }
+inline const std::vector<uint32_t>& Object::limbs() const { return deref<Bignum_>()->limbs; }
+
+inline Equivalence Object::equivalence() const { return deref<Table_>()->kind; }
+inline std::size_t Object::table_count() const { return deref<Table_>()->count; }
+inline const std::vector<TableSlot>& Object::table_slots() const { return deref<Table_>()->slots; }
+
+inline Object Object::record_name() const { return deref<RecordType_>()->name; }
+inline Object Object::record_fields() const { return deref<RecordType_>()->fields; }
+inline Object Object::record_type() const { return deref<Record_>()->rtd; }
+inline void Object::set_record_name(Object name) { deref<RecordType_>()->name = name; }
+inline void Object::set_record_fields(Object fields) { deref<RecordType_>()->fields = fields; }
+inline void Object::set_record_type(Object rtd) { deref<Record_>()->rtd = rtd; }
+inline std::size_t Object::nslots() const { return deref<Record_>()->nslots; }
+inline Object* Object::slots() const { return deref<Record_>()->slots(); }
+
+inline std::size_t Object::builder_size() const { return deref<StringBuilder_>()->size; }
+inline const std::vector<BuilderChunk>& Object::builder_chunks() const {
+    return deref<StringBuilder_>()->chunks;
+}
+
+// Call f with each piece of the contents of a string builder, in order
+template <typename F> inline void Object::builder_pieces(F f) const {
+    const StringBuilder_* builder = deref<StringBuilder_>();
+    std::string_view small = builder->small;
+    std::size_t pos = 0;
+    for (const BuilderChunk& chunk : builder->chunks) {
+        if (chunk.at > pos)
+            f(small.substr(pos, chunk.at - pos));
+        f(chunk.str.text());
+        pos = chunk.at;
+    }
+    if (pos < small.size())
+        f(small.substr(pos));
+}
 
-inline Object Object::car() const { return deref<Pair_>()->car; }
-inline Object Object::cdr() const { return deref<Pair_>()->cdr; }
-inline void Object::set_car(Object car) { deref<Pair_>()->car = car; }
-inline void Object::set_cdr(Object cdr) { deref<Pair_>()->cdr = cdr; }
+inline Object Object::car() const { OBJECT_CHECK(type() == Type::Pair); return deref<Pair_>()->car; }
+inline Object Object::cdr() const { OBJECT_CHECK(type() == Type::Pair); return deref<Pair_>()->cdr; }
+inline void Object::set_car(Object car) {
+    OBJECT_CHECK(type() == Type::Pair);
+    OBJECT_CHECK(!immutable());
+    deref<Pair_>()->car = car;
+}
+inline void Object::set_cdr(Object cdr) {
+    OBJECT_CHECK(type() == Type::Pair);
+    OBJECT_CHECK(!immutable());
+    deref<Pair_>()->cdr = cdr;
+}
 
-inline std::size_t Object::size() const { return deref<Vector_>()->array.size(); }
+inline std::size_t Object::size() const { return immediate() ? 0 : deref<Vector_>()->array.size(); }
 inline void Object::set_size(std::size_t size) { deref<Vector_>()->array.resize(size); }
-inline Object& Object::operator[](std::size_t idx) { return deref<Vector_>()->array[idx]; }
-inline const Object& Object::operator[](std::size_t idx) const { return deref<Vector_>()->array[idx]; }
+inline Object& Object::operator[](std::size_t idx) {
+    OBJECT_CHECK(type() == Type::Vector && idx < size());
+    OBJECT_CHECK(!immutable());
+    return deref<Vector_>()->array[idx];
+}
+inline const Object& Object::operator[](std::size_t idx) const {
+    OBJECT_CHECK(type() == Type::Vector && idx < size());
+    return deref<Vector_>()->array[idx];
+}
 
 inline Object Object::signal() const { return deref<Error_>()->signal; }
 inline Object Object::payload() const { return deref<Error_>()->payload; }
 inline void Object::set_signal(Object signal) { deref<Error_>()->signal = signal; }
 inline void Object::set_payload(Object payload) { deref<Error_>()->payload = payload; }
 
-inline std::vector<Object>::const_iterator Object::begin() { return deref<Vector_>()->array.begin(); }
-inline std::vector<Object>::const_iterator Object::end() { return deref<Vector_>()->array.end(); }
+inline std::vector<Object>::const_iterator Object::begin() {
+    return immediate() ? no_elements.begin() : deref<Vector_>()->array.begin();
+}
+inline std::vector<Object>::const_iterator Object::end() {
+    return immediate() ? no_elements.end() : deref<Vector_>()->array.end();
+}
 
 inline bool operator==(const Object lhs, const Object rhs) { return lhs.data == rhs.data; }
 inline bool operator!=(const Object lhs, const Object rhs) { return lhs.data != rhs.data; }
@@ -192,7 +512,8 @@ std::ostream& operator<<(std::ostream& out, Object obj);
 
 #define FOR_LIST(obj, elt, tail)                \
     Object tail = obj;                          \
-    Object elt = obj.car();                     \
+    Object elt = obj.type() == Type::Pair ?     \
+        obj.car() : Object::Undefined;          \
     for(; tail.type() == Type::Pair;            \
         tail = tail.cdr(),                      \
         elt = tail.type() == Type::Pair ?       \
@@ -1,239 +1,507 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <list>
+#include <mutex>
 #include <sstream>
-
+#include <thread>
+#include <unordered_map>
+
+#include "charclass.h"
+#include "file.h"
+#include "gc.h"
+#include "number.h"
+#include "numvector.h"
 #include "object.h"
+#include "simd.h"
+#include "utf8.h"
 #include "vm.h"
 
 #include "parse.h"
 
 
-std::ostream& operator<<(std::ostream& out, Token& token)
+std::ostream& operator<<(std::ostream& out, const Token& token)
 {
-    out << token.string();
+    out << token.text();
     return out;
 }
 
 
-static void read_identifier(std::istream& source, Token& token)
+// Read the next chunk of a stream, once the current one is used up
+bool Lexer::refill()
+{
+    if (!stream)
+        return false;
+
+    // Save what we have of a token that continues into the next chunk
+    if (scanning) {
+        if (!spilled)
+            spills[spill].clear();
+        spills[spill].append(mark, end);
+        spilled = true;
+    }
+
+    // Leave the buffer of the token last handed out alone
+    if (buffer == pinned)
+        buffer = 1 - buffer;
+
+    std::string& chunk = buffers[buffer];
+    base += end - begin;
+    chunk.resize(LEXER_CHUNK_SIZE);
+    stream->read(&chunk[0], chunk.size());
+    chunk.resize(stream->gcount());
+    begin = cur = mark = chunk.data();
+    end = begin + chunk.size();
+    return cur < end;
+}
+
+// The text of the token being scanned, up to the current position
+std::string_view Lexer::current()
 {
-    while (true) {
-        char e = source.get();
-        if (e != '(' && e != ')' && e != '[' && e != ']' && e != '"' &&
-            e != ',' && e != '`' && e != '\'' && e != EOF && !std::isspace(e))
-            token.push_back(e);
-        else {
-            source.unget();
+    if (!spilled)
+        return std::string_view(mark, cur - mark);
+    spills[spill].append(mark, cur);
+    mark = cur;
+    return spills[spill];
+}
+
+// Skip the rest of an identifier, telling whether all of it could
+// continue a symbol
+bool Lexer::skip_identifier()
+{
+    uint8_t classes = CHAR_SUBSEQUENT;
+    while (more()) {
+        const char* start = cur;
+        cur = simd_find_delimiter(cur, end);
+        for (; start < cur; start++)
+            classes &= char_classes[(unsigned char)*start];
+        if (cur < end)
             break;
-        }
     }
+    return classes & CHAR_SUBSEQUENT;
 }
 
-void Lexer::read()
+// Skip a line comment, up to and including the newline. Nothing of
+// comments is kept, so they are not spilled across chunks.
+void Lexer::skip_line()
 {
-    while (std::isspace(source.peek()))
-        get();
+    scanning = false;
+    while (more())
+        if ((cur = simd_find_newline(cur, end)) < end) {
+            cur++;
+            return;
+        }
+}
+
+// Skip the rest of a block comment, which may contain nested ones
+void Lexer::skip_block()
+{
+    scanning = false;
+    std::size_t depth = 1;
+    while (depth > 0 && more()) {
+        if ((cur = simd_find_block(cur, end)) == end)
+            continue;
+        char c = *cur++;
+        if (c == '|' && peek_char() == '#') {
+            cur++;
+            depth--;
+        }
+        else if (c == '#' && peek_char() == '|') {
+            cur++;
+            depth++;
+        }
+    }
+}
 
-    token = Token(pos);
-    int c, d, e;
-    bool escaped = false;
+// Skip the rest of a string literal, up to and including the closing quote
+void Lexer::skip_string()
+{
+    while (more()) {
+        if ((cur = simd_find_quote(cur, end)) == end)
+            continue;
+        if (*cur++ == '"' || get() == EOF)
+            return;
+    }
+}
 
-    switch ((c = get()))
+TokenKind Lexer::scan()
+{
+    int c = get();
+    switch (c)
     {
-    case EOF: return;
-    case '(': case ')': case '[': case ']': case '`': case '\'':
-        token.push_back(c);
-        return;
+    case EOF: return TokenKind::End;
+    case '(': return TokenKind::Open;
+    case ')': return TokenKind::Close;
+    case '[': return TokenKind::OpenBracket;
+    case ']': return TokenKind::CloseBracket;
+    case ';':
+        skip_line();
+        return TokenKind::Comment;
+    case '\'': return TokenKind::Quote;
+    case '`': return TokenKind::Quasiquote;
     case ',':
-        if ((d = get()) == '@')
-            token = ",@";
-        else {
-            unget();
-            token = ",";
-        }
-        break;
+        if (peek_char() != '@')
+            return TokenKind::Unquote;
+        cur++;
+        return TokenKind::UnquoteSplicing;
     case '"':
-        token = "\"";
-        escaped = false;
-        while (true) {
-            e = get();
-            if (escaped) {
-                token.push_back(e);
-                escaped = false;
-            }
-            else if (e == '\\') {
-                token.push_back(e);
-                escaped = true;
-            }
-            else {
-                if (e != EOF)
-                    token.push_back(e);
-                if (e == '"' || e == EOF)
-                    return;
-            }
-        }
+        skip_string();
+        return TokenKind::String;
     case '#':
-        token.push_back((char)c);
-        token.push_back(get());
-        if (token == "#(" || token == "#t" || token == "#f")
-            return;
-        read_identifier(source, token);
-        break;
-    default:
-        token.push_back((char)c);
-        read_identifier(source, token);
+        switch (get()) {
+        case '(':
+            return TokenKind::OpenVector;
+        case '|':
+            skip_block();
+            return TokenKind::Comment;
+        case ';':
+            return TokenKind::DatumComment;
+        case '\\':
+            // The character after the backslash is taken even if it is a
+            // delimiter, as in #\( and #\space
+            get();
+            skip_identifier();
+            return TokenKind::Character;
+        }
+        skip_identifier();
+
+        // Numeric vector openers like #u8( and #f64( are single tokens
+        Numeric kind;
+        if (peek_char() == '(' && numeric_from_tag(current().substr(1), kind)) {
+            cur++;
+            return TokenKind::OpenNumVector;
+        }
+        return TokenKind::Atom;
+    default: {
+        // Symbols are recognized here, in the same pass as the lexing
+        if (skip_identifier() && char_is(c, CHAR_INITIAL))
+            return TokenKind::Symbol;
+        std::string_view text = current();
+        if (text == "+" || text == "-" || text == "...")
+            return TokenKind::Symbol;
+        return text == "." ? TokenKind::Dot : TokenKind::Atom;
+    }
     }
 }
 
-static std::string initials = "!$%&*/:<=>?~_^";
-static std::string subsequents = ".+-";
-
-static bool legal_symbol(const Token& token)
+// Scan the next token, past whitespace and comments
+TokenKind Lexer::next()
 {
-    if (token == "+" || token == "-" || token == "...")
-        return true;
+    TokenKind kind;
+    do {
+        while (more() && (cur = simd_skip_space(cur, end)) == end) ;
+        start = pos();
+        mark = cur;
+        spilled = false;
+        scanning = true;
+    } while ((kind = scan()) == TokenKind::Comment);
+    return kind;
+}
 
-    char init = token[0];
-    if ((init < 'a' || init > 'z') && (init < 'A' || init > 'Z')
-        && initials.find(init) == std::string::npos)
-        return false;
+// Skip the datum after #; by its tokens, so that nothing is allocated for
+// it, and return the kind of the token that follows
+TokenKind Lexer::skip_datum()
+{
+    std::size_t pending = 1, depth = 0;
+    for (;;) {
+        switch (TokenKind kind = next()) {
+        case TokenKind::End:
+            return kind;
+        case TokenKind::Open: case TokenKind::OpenBracket:
+        case TokenKind::OpenVector: case TokenKind::OpenNumVector:
+            depth++;
+            continue;
+        case TokenKind::Close: case TokenKind::CloseBracket:
+            // A close with nothing before it is left for the reader
+            if (depth == 0)
+                return kind;
+            depth--;
+            break;
 
-    for (char c : token.substr(1))
-        if ((c < 'a' || c > 'z') && (c < 'A' || c > 'Z')
-            && initials.find(c) == std::string::npos && subsequents.find(c) == std::string::npos)
-            return false;
+        // Prefixes are followed by their datum, and datum comments at the
+        // top level by one more to skip
+        case TokenKind::Quote: case TokenKind::Quasiquote:
+        case TokenKind::Unquote: case TokenKind::UnquoteSplicing:
+            continue;
+        case TokenKind::DatumComment:
+            if (depth == 0)
+                pending++;
+            continue;
+        default:
+            break;
+        }
+        if (depth == 0 && --pending == 0)
+            return next();
+    }
+}
 
-    return true;
+void Lexer::read()
+{
+    // The token about to be handed out must survive this read
+    pinned = token_buffer;
+    spill = 1 - spill;
+
+    TokenKind kind = next();
+    while (kind == TokenKind::DatumComment)
+        kind = skip_datum();
+    std::string_view text = current();
+    scanning = false;
+    token = Token(kind, text, start);
+    token_buffer = spilled ? -1 : buffer;
 }
 
-static void error(Token& token, std::string msg)
+// Form a list from the top nelems items and the tail pushed above them
+static void make_list(std::size_t nelems, bool hashcons)
 {
-    std::ostringstream payload;
-    payload << "At " << token.position() << ": " << msg;
-    VM::Intern("parse");
-    VM::String(payload.str());
-    Op::error();
+    if (!hashcons)
+        Op::list(nelems, false);
+    else
+        for (; nelems > 0; nelems--)
+            Op::pooled_cons();
 }
 
+// The reader hands what it reads to a builder, which builds the data on
+// the VM's stack
+class Builder {
+public:
+    Builder(bool hashcons) : hashcons(hashcons) { }
+
+    inline void symbol(std::string_view name) { Op::intern(name); }
+    inline void boolean(bool value) { VM::push(value ? Object::True : Object::False); }
+    inline bool number(std::string_view text) { return read_number(text); }
+    inline void character(char32_t c) { VM::push(VM::Character(c)); }
+    inline void string(std::string_view data) {
+        if (hashcons)
+            Op::pooled_string(data);
+        else
+            Op::string(data);
+    }
+    inline void numvector(Numeric kind, const char* data, std::size_t n) {
+        VM::NumVector(kind, data, n);
+    }
+
+    // Lists without a tail from a period end with the empty list
+    inline void list(std::size_t nelems, bool dotted) {
+        if (!dotted)
+            VM::push(Object::EmptyList);
+        make_list(nelems, hashcons);
+    }
+    inline void vector(std::size_t nelems) {
+        if (hashcons)
+            Op::pooled_vector(nelems);
+        else
+            Op::vector(nelems);
+    }
+
+    void error(std::size_t position, std::string_view msg) {
+        std::ostringstream payload;
+        payload << "At " << position << ": " << msg;
+        Op::intern("parse");
+        Op::string(payload.str());
+        Op::error();
+    }
+    inline bool failed() const { return VM::has_error(); }
+
+private:
+    bool hashcons;
+};
+
 #define ERROR(token, msg)                                               \
-    do { error((token), (msg)); return; } while (0)
+    do { out.error((token).position(), (msg)); return; } while (0)
 #define ERROR_IF(cond, token, msg)                                      \
     do { if (cond) ERROR(token, msg); } while (0)
-#define READ_OR_ERROR(token, msg)                                       \
-    read_datum(source);                                                 \
-    RETURN_IF_ERROR;                                                    \
-    ERROR_IF(VM::peek().undefined(), token, msg)
 
-void read_datum(Lexer& source)
+// Read one datum. Lists, vectors and quotations being read are kept on an
+// explicit stack rather than by recursion, so depth is only limited by
+// memory; their elements wait on the VM's stack.
+template <typename Out>
+static void read_datum(Lexer& lexer, Out& out, std::vector<Nested>& nesting)
 {
-    // If we return Undefined without setting an error, it signals EOF
-    if (!source) {
-        VM::push(Object::Undefined);
-        return;
-    }
+    nesting.clear();
+    for (;;) {
+        Token token;
+        ERROR_IF(!lexer, nesting.back().opener, "quotation must have an argument");
+        lexer >> token;
+
+        bool complete = true;
+        switch (token.kind()) {
+        case TokenKind::Symbol:
+            out.symbol(token.text());
+            break;
+
+        case TokenKind::Atom:
+            if (token == "#t" || token == "#true")
+                out.boolean(true);
+            else if (token == "#f" || token == "#false")
+                out.boolean(false);
+            else
+                ERROR_IF(!out.number(token.text()), token, "unknown token");
+            break;
 
-    Token token;
-    source >> token;
-
-    if (token == "#t")
-        VM::push(Object::True);
-    else if (token == "#f")
-        VM::push(Object::False);
-
-    // String parsing
-    else if (token[0] == '"') {
-        ERROR_IF(token.size() < 2 || token[token.size()-1] != '"', token, "unmatched quote");
-        token = token.substr(1, token.size()-2);
-        std::string value;
-        bool escaped = false;
-        for (char c : token) {
-            if (!escaped && c == '\\') {
-                escaped = true;
-                continue;
+        // Characters: #\a, #\space or #\x41
+        case TokenKind::Character: {
+            std::string_view name = token.text().substr(2);
+            const char* pos = name.data();
+            const char* end = pos + name.size();
+            ERROR_IF(name.empty(), token, "missing character");
+            char32_t c = utf8_decode(pos, end);
+            if (pos < end && !char_from_name(name, c)) {
+                uint32_t cp;
+                auto [ptr, ec] = std::from_chars(name.data() + 1, end, cp, 16);
+                ERROR_IF(name[0] != 'x' || ptr != end || ec != std::errc() || cp > 0x10ffff,
+                         token, "unknown character name");
+                c = cp;
             }
-            else if (!escaped)
-                value.push_back(c);
-            else if (escaped) {
-                switch (c) {
-                case '\\': case '"':
-                    value.push_back(c); break;
-                case 'n': value.push_back('\n'); break;
-                case 't': value.push_back('\t'); break;
-                default: ERROR(token, "unknown escape sequence");
+            out.character(c);
+            break;
+        }
+
+        // String parsing; only strings with escapes need a copy to unescape
+        case TokenKind::String: {
+            ERROR_IF(token.size() < 2 || token[token.size()-1] != '"', token, "unmatched quote");
+            std::string_view body = token.text().substr(1, token.size()-2);
+            std::string value;
+            if (body.find('\\') != std::string_view::npos) {
+                for (std::size_t i = 0; i < body.size(); i++) {
+                    if (body[i] != '\\') {
+                        value.push_back(body[i]);
+                        continue;
+                    }
+                    ERROR_IF(++i == body.size(), token, "unmatched quote");
+                    switch (body[i]) {
+                    case '\\': case '"':
+                        value.push_back(body[i]); break;
+                    case 'n': value.push_back('\n'); break;
+                    case 't': value.push_back('\t'); break;
+                    default: ERROR(token, "unknown escape sequence");
+                    }
                 }
-                escaped = false;
+                body = value;
             }
+            out.string(body);
+            break;
         }
-        if (escaped)
-            ERROR(token, "should never happen");
-        Op::string(value);
-    }
 
-    // List parsing
-    else if (token == "(") {
-        std::size_t nelems = 0;
-        while (source && source.peek() != ")" && source.peek() != ".") {
-            READ_OR_ERROR(token, "unmatched paranthesis");
-            nelems++;
-        }
+        // Bytevector and numeric vector parsing, storing elements directly
+        case TokenKind::OpenNumVector: {
+            Numeric kind;
+            numeric_from_tag(token.text().substr(1, token.size()-2), kind);
+            std::size_t width = numeric_width(kind);
+            std::vector<char> data;
+            while (lexer && lexer.peek().kind() != TokenKind::Close) {
+                Token elt;
+                lexer >> elt;
+                data.resize(data.size() + width);
+                ERROR_IF(!numeric_parse(kind, elt.text(), &data[data.size()-width]),
+                         elt, std::string("invalid ") + numeric_tag(kind) + " element");
+            }
 
-        // At this point, we have EOF, a closing paren or a period
-        // Error if it's EOF
-        ERROR_IF(!source, token, "unmatched paranthesis");
-        source >> token;
+            ERROR_IF(!lexer, token, "unmatched paranthesis");
+            lexer >> token;        // Closing parenthesis
 
-        // Get the last cdr
-        if (token == ".") {
-            READ_OR_ERROR(token, "unmatched paranthesis");
-            ERROR_IF(!source, token, "unmatched paranthesis");
-            source >> token;
+            out.numvector(kind, data.data(), data.size() / width);
+            break;
         }
-        else { VM::push(Object::EmptyList); }
 
-        // Last token must be a closing paren
-        ERROR_IF(token != ")", token, "unmatched paranthesis");
+        // Lists, vectors and quotations are completed once their elements
+        // have been read
+        case TokenKind::Open:
+        case TokenKind::OpenVector:
+            nesting.push_back({token, 0, false, false});
+            complete = false;
+            break;
 
-        // Form the pairs
-        Op::list(nelems, false);
-    }
+        case TokenKind::Quote:
+        case TokenKind::Quasiquote:
+        case TokenKind::Unquote:
+        case TokenKind::UnquoteSplicing:
+            if (token.kind() == TokenKind::Quote) out.symbol("quote");
+            if (token.kind() == TokenKind::Quasiquote) out.symbol("quasiquote");
+            if (token.kind() == TokenKind::Unquote) out.symbol("unquote");
+            if (token.kind() == TokenKind::UnquoteSplicing) out.symbol("unquote-splicing");
+            nesting.push_back({token, 0, false, false});
+            complete = false;
+            break;
 
-    // Vector parsing
-    else if (token == "#(") {
-        std::size_t nelems = 0;
-        while (source && source.peek() != ")") {
-            READ_OR_ERROR(token, "unmatched paranthesis");
-            nelems++;
+        default:
+            ERROR(token, "unknown token");
         }
+        if (out.failed())
+            return;
 
-        ERROR_IF(!source, token, "unmatched paranthesis");
-        source >> token;        // Closing parenthesis
+        for (;;) {
+            // Add a complete datum to what encloses it, which completes
+            // quotations in turn
+            if (complete) {
+                if (nesting.empty())
+                    return;
+                Nested& top = nesting.back();
+                if (top.quotation()) {
+                    out.list(2, false);
+                    nesting.pop_back();
+                    continue;
+                }
+                if (top.dotted)
+                    top.tail = true;
+                else
+                    top.nelems++;
+                complete = false;
+            }
 
-        Op::vector(nelems);
-    }
+            // A quotation needs its datum; a list or vector may end here
+            Nested& top = nesting.back();
+            if (top.quotation())
+                break;
+            ERROR_IF(!lexer, top.opener, "unmatched paranthesis");
+            TokenKind next = lexer.peek().kind();
+
+            if (next == TokenKind::Dot && top.opener.kind() == TokenKind::Open && !top.dotted) {
+                lexer >> token;
+                top.dotted = true;
+                ERROR_IF(!lexer, token, "unmatched paranthesis");
+                break;
+            }
+            if (next != TokenKind::Close) {
+                ERROR_IF(top.tail, lexer.peek(), "unmatched paranthesis");
+                break;
+            }
 
-    // Quoted structures
-    else if (token == "'" || token == "`" || token == "," || token == ",@") {
-        if (token == "'") VM::Intern("quote");
-        if (token == "`") VM::Intern("quasiquote");
-        if (token == ",") VM::Intern("unquote");
-        if (token == ",@") VM::Intern("unquote-splicing");
-        READ_OR_ERROR(token, "quotation must have an argument");
-        Op::list(2);
+            lexer >> token;        // Closing parenthesis
+            if (top.opener.kind() == TokenKind::OpenVector)
+                out.vector(top.nelems);
+            else
+                out.list(top.nelems, top.dotted);
+            nesting.pop_back();
+            complete = true;
+        }
     }
+}
 
-    else if (legal_symbol(token))
-        Op::intern(token.string());
-
-    else
-        error(token, "unknown token");
+Object Reader::read()
+{
+    // Undefined without an error signals the end of the input
+    if (!lexer) {
+        VM::push(Object::Undefined);
+        return Object::Undefined;
+    }
+    // Drop what was read of a malformed datum
+    std::size_t depth = VM::stack_size();
+    Builder out(hashcons);
+    read_datum(lexer, out, nesting);
+    if (VM::has_error()) {
+        VM::pop(VM::stack_size() - depth);
+        VM::push(Object::Undefined);
+    }
+    return VM::peek();
 }
 
-void parse_all(std::istream& stream)
+static void parse_all(Reader& reader)
 {
     VM::push_frame();
 
-    Lexer source(stream);
     std::size_t nelems = 0;
-    while (source && !VM::has_error()) {
-        read_datum(source);
+    while (reader && !VM::has_error()) {
+        reader.read();
         nelems++;
     }
 
@@ -243,6 +511,234 @@ void parse_all(std::istream& stream)
     Op::ret();
 }
 
+void parse_all(std::istream& stream, bool hashcons)
+{
+    Reader reader(stream, hashcons);
+    parse_all(reader);
+}
+
+void parse_all(std::string_view data, bool hashcons)
+{
+    Reader reader(data, hashcons);
+    parse_all(reader);
+}
+
+
+// Builds data on a thread reading one chunk of a larger input. The
+// symbol table is shared between the threads, so symbols are interned
+// under a lock, once per name and chunk.
+class ChunkBuilder : public Builder {
+public:
+    ChunkBuilder(std::mutex& symbols) : Builder(false), symbols(symbols) { }
+
+    inline void symbol(std::string_view name) {
+        auto it = interned.find(name);
+        if (it == interned.end()) {
+            std::lock_guard<std::mutex> lock(symbols);
+            it = interned.emplace(name, VM::Intern(name)).first;
+        }
+        VM::push(it->second);
+    }
+
+    void error(std::size_t position, std::string_view msg) {
+        std::lock_guard<std::mutex> lock(symbols);
+        Builder::error(position, msg);
+    }
+
+private:
+    std::mutex& symbols;
+    std::unordered_map<std::string_view, Object> interned;
+};
+
+// A chunk of the input, and what was read from it: a list of its data
+// ending with the pair last, or the error it raised. The objects are in
+// a heap of the chunk's own until the calling thread adopts them.
+struct Chunk {
+    std::string_view text;
+    std::size_t base;
+    std::list<Object> heap;
+    Object data = Object::EmptyList;
+    Object last;
+    Object error;
+
+    void read(std::mutex& symbols);
+};
+
+void Chunk::read(std::mutex& symbols)
+{
+    VMState state;
+    VM::use_state(&state);
+    GC::use_heap(&heap);
+
+    VM::push_frame();
+    Lexer lexer(text, base);
+    ChunkBuilder out(symbols);
+    std::vector<Nested> nesting;
+    std::size_t ndata = 0;
+    while (lexer && !VM::has_error()) {
+        read_datum(lexer, out, nesting);
+        ndata++;
+    }
+
+    if (VM::has_error())
+        error = VM::get_error();
+    else if (ndata > 0) {
+        Op::list(ndata);
+        data = last = VM::pop();
+        while (last.cdr() != Object::EmptyList)
+            last = last.cdr();
+    }
+
+    GC::use_heap(nullptr);
+    VM::use_state(nullptr);
+}
+
+// Offsets at which the input can be cut into chunks of at least target
+// bytes of whole top-level data: after a list that ends at the top level,
+// outside strings and comments, unless a top-level #; may still need a
+// datum. Datum comments are only undone by lists here, which errs on the
+// side of fewer cuts.
+static std::vector<std::size_t> split_points(std::string_view data, std::size_t target)
+{
+    std::vector<std::size_t> cuts;
+    const char* begin = data.data();
+    const char* end = begin + data.size();
+    const char* last = begin;
+    std::size_t depth = 0, pending = 0;
+
+    for (const char* pos = begin; (pos = simd_find_structural(pos, end)) < end; ) {
+        switch (*pos++) {
+        case '(': case '[':
+            depth++;
+            break;
+        case ')': case ']':
+            if (depth == 0 || --depth > 0)
+                break;
+            if (pending > 0)
+                pending--;
+            else if ((std::size_t)(pos - last) >= target && pos < end) {
+                cuts.push_back(pos - begin);
+                last = pos;
+            }
+            break;
+        case '"':
+            while ((pos = simd_find_quote(pos, end)) < end && *pos++ != '"')
+                pos += pos < end;   // Escaped character
+            break;
+        case ';':
+            pos = simd_find_newline(pos, end);
+            break;
+        case '#':
+            // Only special at the start of a token, as in a#|b
+            if ((pos - 1 > begin && !char_is(pos[-2], CHAR_DELIMITER)) || pos == end)
+                break;
+            if (*pos == '\\')
+                pos = std::min(pos + 2, end);
+            else if (*pos == ';') {
+                pos++;
+                pending += depth == 0;
+            }
+            else if (*pos == '|') {
+                pos++;
+                for (std::size_t nested = 1; nested > 0 && (pos = simd_find_block(pos, end)) < end; ) {
+                    char c = *pos++;
+                    if (c == '|' && pos < end && *pos == '#') {
+                        pos++;
+                        nested--;
+                    }
+                    else if (c == '#' && pos < end && *pos == '|') {
+                        pos++;
+                        nested++;
+                    }
+                }
+            }
+            break;
+        }
+    }
+    return cuts;
+}
+
+void parse_parallel(std::string_view data, bool hashcons, unsigned nthreads)
+{
+    if (nthreads == 0)
+        nthreads = std::max(1u, std::thread::hardware_concurrency());
+
+    // A few chunks per thread even out their differences in cost. The
+    // literal pool is not safe to share between threads.
+    std::vector<std::size_t> cuts;
+    if (!hashcons && nthreads > 1 && data.size() >= 2 * PARSE_CHUNK_MIN)
+        cuts = split_points(data, std::max<std::size_t>(PARSE_CHUNK_MIN, data.size() / (4 * nthreads)));
+    if (cuts.empty()) {
+        parse_all(data, hashcons);
+        return;
+    }
+    cuts.insert(cuts.begin(), 0);
+    cuts.push_back(data.size());
+
+    std::size_t nchunks = cuts.size() - 1;
+    std::vector<Chunk> chunks(nchunks);
+    for (std::size_t i = 0; i < nchunks; i++) {
+        chunks[i].text = data.substr(cuts[i], cuts[i+1] - cuts[i]);
+        chunks[i].base = cuts[i];
+    }
+
+    // Chunks are taken in order, so once one fails, every chunk before it
+    // has been taken and the rest are not needed. The calling thread
+    // takes chunks too.
+    std::mutex symbols;
+    std::atomic<std::size_t> next(0);
+    auto work = [&] {
+        for (std::size_t i; (i = next++) < nchunks; ) {
+            chunks[i].read(symbols);
+            if (chunks[i].error.defined())
+                next = nchunks;
+        }
+    };
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < std::min<std::size_t>(nthreads, nchunks); i++)
+        workers.emplace_back(work);
+    work();
+    for (std::thread& worker : workers)
+        worker.join();
+
+    // Every heap is adopted, as even those of failed chunks hold symbols.
+    // Nothing is allocated until the result is on the stack.
+    Object head = Object::EmptyList, tail, error;
+    for (Chunk& chunk : chunks) {
+        GC::adopt(chunk.heap);
+        if (error.undefined())
+            error = chunk.error;
+        if (error.defined() || chunk.data == Object::EmptyList)
+            continue;
+        if (tail.defined())
+            tail.set_cdr(chunk.data);
+        else
+            head = chunk.data;
+        tail = chunk.last;
+    }
+
+    if (error.defined()) {
+        VM::set_error(error);
+        VM::push(Object::Undefined);
+    }
+    else
+        VM::push(head);
+}
+
+void parse_file(const std::string& path, bool hashcons)
+{
+    MappedFile file(path);
+    if (!file) {
+        Op::intern("parse");
+        Op::string("cannot open " + path);
+        Op::error();
+        VM::push(Object::Undefined);
+        return;
+    }
+    Reader reader(std::string_view(file.data(), file.size()), hashcons);
+    parse_all(reader);
+}
+
 void parse_toplevel(std::istream& stream)
 {
     VM::push_frame();
@@ -1,4 +1,7 @@
 #include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "vm.h"
 
@@ -9,43 +12,68 @@
 #define PARSE_H
 
 
+enum class TokenKind {
+    End,                        // No more input
+    Open, Close,                // ( and )
+    OpenBracket, CloseBracket,  // [ and ]
+    OpenVector,                 // #(
+    OpenNumVector,              // #u8(, #f64( and so on
+    Quote, Quasiquote, Unquote, UnquoteSplicing,
+    Dot,
+    String,                     // With quotes and escapes as written
+    Character,                  // #\ and a character or its name
+    Symbol,                     // Identifiers that are legal symbols
+    Atom,                       // Anything else: numbers, #t...
+
+    // Only seen inside the lexer, which skips comments
+    Comment,                    // ; to end of line, or #| |#
+    DatumComment                // #;, commenting out the next datum
+};
+
+// Tokens do not own their text, which is a view into the lexer's input.
+// It stays valid until the lexer has moved two tokens further.
 class Token {
 public:
-    Token() : value(""), pos(0) { }
-    Token(std::size_t pos) : pos(pos) { }
-    Token(std::string value, std::size_t pos) : value(value), pos(pos) { }
+    Token() : _kind(TokenKind::End), pos(0) { }
+    Token(TokenKind kind, std::string_view text, std::size_t pos) : _kind(kind), _text(text), pos(pos) { }
+    inline TokenKind kind() const { return _kind; }
+    inline std::string_view text() const { return _text; }
+    inline std::string string() const { return std::string(_text); }
     inline std::size_t position() const { return pos; }
-    inline const std::string& string() const { return value; }
-
-    inline friend bool operator==(const Token& lhs, const std::string& rhs);
-    inline friend bool operator!=(const Token& lhs, const std::string& rhs);
-    inline Token& operator=(const std::string& rhs) { value = rhs; return *this; }
 
-    inline void push_back(char c) { value.push_back(c); }
-    inline char operator[](std::size_t idx) const { return value[idx]; }
-    inline std::size_t size() const { return value.size(); }
-    inline Token substr(std::size_t start = 0, std::size_t len = std::string::npos) const {
-        return Token(value.substr(start, len), pos + start);
-    }
+    inline friend bool operator==(const Token& lhs, std::string_view rhs) { return lhs._text == rhs; }
+    inline friend bool operator!=(const Token& lhs, std::string_view rhs) { return lhs._text != rhs; }
 
-    inline std::string::const_iterator begin() const { return value.begin(); }
-    inline std::string::const_iterator end() const { return value.end(); }
+    inline char operator[](std::size_t idx) const { return _text[idx]; }
+    inline std::size_t size() const { return _text.size(); }
 
 private:
-    std::string value;
+    TokenKind _kind;
+    std::string_view _text;
     std::size_t pos;
 };
 
-inline bool operator==(const Token& lhs, const std::string& rhs) { return lhs.value == rhs; }
-inline bool operator!=(const Token& lhs, const std::string& rhs) { return lhs.value != rhs; }
+std::ostream& operator<<(std::ostream& out, const Token& token);
 
-std::ostream& operator<<(std::ostream& out, Token& token);
 
+// Input is scanned with plain pointers over a contiguous buffer: either
+// memory owned by the caller (a string or a mapped file), which must
+// outlive the lexer, or chunks of LEXER_CHUNK_SIZE bytes read from a
+// stream. Stream chunks alternate between two buffers so that the token
+// last handed out survives a refill; tokens that span chunks are copied
+// into one of two spill strings.
+#define LEXER_CHUNK_SIZE 65536
 
 class Lexer {
 public:
-    Lexer(std::istream& s) : pos(0), source(s) { read(); }
-    explicit operator bool() const { return token != ""; }
+    // Positions count from base, for data that is part of a larger input
+    Lexer(const char* data, std::size_t size, std::size_t base = 0)
+        : stream(nullptr), base(base), begin(data), cur(data), end(data + size) { read(); }
+    Lexer(std::string_view data, std::size_t base = 0) : Lexer(data.data(), data.size(), base) { }
+    Lexer(std::istream& s) : stream(&s), base(0), begin(nullptr), cur(nullptr), end(nullptr) { read(); }
+    Lexer(const Lexer&) = delete;
+    Lexer& operator=(const Lexer&) = delete;
+    explicit operator bool() const { return token.kind() != TokenKind::End; }
 
     Lexer& operator>>(Token& t) {
         t = token;
@@ -57,16 +85,97 @@ public:
 
 private:
     void read();
-    inline char get() { pos++; return source.get(); }
-    inline void unget() { pos--; source.unget(); }
-
-    std::size_t pos;
-    std::istream& source;
+    TokenKind next();
+    TokenKind skip_datum();
+    TokenKind scan();
+    bool skip_identifier();
+    void skip_string();
+    void skip_line();
+    void skip_block();
+    std::string_view current();
+    bool refill();
+
+    // Whether there is input left, refilling the buffer if needed
+    inline bool more() { return cur < end || refill(); }
+    inline int peek_char() { return more() ? (unsigned char)*cur : EOF; }
+    inline int get() { return more() ? (unsigned char)*cur++ : EOF; }
+    inline std::size_t pos() const { return base + (cur - begin); }
+
+    std::istream* stream;
+    std::size_t base;           // Offset of begin in the whole input
+    const char* begin;
+    const char* cur;
+    const char* end;
+    std::size_t start = 0;      // Position of the token being scanned
     Token token;
+
+    // Stream buffers, and the one holding the token last handed out (if any)
+    std::string buffers[2];
+    int buffer = 0;
+    int pinned = -1;
+    int token_buffer = -1;
+
+    // The token being scanned starts at mark, or in spill if it is spilled
+    const char* mark = nullptr;
+    bool scanning = false;
+    bool spilled = false;
+    std::string spills[2];
+    int spill = 0;
 };
 
 
-void parse_all(std::istream& stream);
+// A list, vector or quotation being read. Only the opener's position is
+// used once the lexer has moved past it.
+struct Nested {
+    Token opener;
+    std::size_t nelems;
+    bool dotted;                // A list whose period has been read
+    bool tail;                  // ... and the datum after it
+
+    bool quotation() const {
+        return opener.kind() != TokenKind::Open && opener.kind() != TokenKind::OpenVector;
+    }
+};
+
+// Reads one top-level datum at a time, so that callers can process and
+// drop each before reading the next, in memory bounded by the largest
+// datum rather than by the input. With hashcons, pairs, vectors and
+// strings are shared through the literal pool (see pool.h), so identical
+// data is only allocated once.
+class Reader {
+public:
+    Reader(std::istream& stream, bool hashcons = false) : lexer(stream), hashcons(hashcons) { }
+    Reader(std::string_view data, bool hashcons = false) : lexer(data), hashcons(hashcons) { }
+
+    // Whether there is another datum to read
+    explicit operator bool() const { return bool(lexer); }
+
+    // Push the next datum and return it. At the end of the input this is
+    // Undefined, as it is for a malformed datum, which sets the error.
+    Object read();
+
+private:
+    Lexer lexer;
+    bool hashcons;
+    std::vector<Nested> nesting;
+};
+
+
+// Read all the data into a list
+void parse_all(std::istream& stream, bool hashcons = false);
+void parse_all(std::string_view data, bool hashcons = false);
+void parse_file(const std::string& path, bool hashcons = false);
+
+// Read all the data into a list, splitting the input between nthreads
+// threads (by default, one per processor). Chunks are cut where a list
+// ends at the top level, outside strings and comments, and each thread
+// builds the data of the chunks it takes on VM state and a heap of its
+// own, which are then handed to the calling thread. Hash-consed data and
+// inputs smaller than a few chunks of PARSE_CHUNK_MIN bytes are read on
+// the calling thread alone.
+#define PARSE_CHUNK_MIN (256 * 1024)
+
+void parse_parallel(std::string_view data, bool hashcons = false, unsigned nthreads = 0);
 void parse_toplevel(std::istream& stream);
 
 
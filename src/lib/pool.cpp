@@ -0,0 +1,120 @@
+#include "hash.h"
+#include "object.h"
+#include "vm.h"
+
+#include "pool.h"
+
+
+std::unordered_map<std::pair<uint64_t, uint64_t>, Object, LiteralPool::PairHash> LiteralPool::pairs;
+std::unordered_map<std::string_view, Object> LiteralPool::vectors;
+std::unordered_map<std::string_view, Object> LiteralPool::strings;
+
+
+static inline std::string_view words(const Object* elements, std::size_t nelems)
+{
+    return std::string_view((const char*)elements, nelems * sizeof(Object));
+}
+
+std::size_t LiteralPool::PairHash::operator()(const std::pair<uint64_t, uint64_t>& key) const
+{
+    return hash_eq(Object(key.first)) ^ (hash_eq(Object(key.second)) * 31);
+}
+
+Object LiteralPool::find_pair(Object car, Object cdr)
+{
+    auto it = pairs.find(std::make_pair(car.view(), cdr.view()));
+    return it == pairs.end() ? Object::Undefined : it->second;
+}
+
+Object LiteralPool::find_vector(const Object* elements, std::size_t nelems)
+{
+    auto it = vectors.find(words(elements, nelems));
+    return it == vectors.end() ? Object::Undefined : it->second;
+}
+
+Object LiteralPool::find_string(std::string_view data)
+{
+    auto it = strings.find(data);
+    return it == strings.end() ? Object::Undefined : it->second;
+}
+
+void LiteralPool::insert(Object obj)
+{
+    // Immediates are canonical already
+    if (obj.immediate())
+        return;
+    switch (obj.type()) {
+    case Type::Pair:
+        pairs[std::make_pair(obj.car().view(), obj.cdr().view())] = obj;
+        break;
+    case Type::Vector:
+        vectors[words(obj.size() > 0 ? &obj[0] : nullptr, obj.size())] = obj;
+        break;
+    case Type::String:
+        strings[obj.text()] = obj;
+        break;
+    default:
+        break;
+    }
+    obj.set_immutable(true);
+}
+
+template <typename Map> static void sweep_map(Map& map)
+{
+    for (auto it = map.begin(); it != map.end(); )
+        it = it->second.marked() ? std::next(it) : map.erase(it);
+}
+
+void LiteralPool::sweep()
+{
+    sweep_map(pairs);
+    sweep_map(vectors);
+    sweep_map(strings);
+}
+
+void LiteralPool::clear()
+{
+    pairs.clear();
+    vectors.clear();
+    strings.clear();
+}
+
+std::size_t LiteralPool::size()
+{
+    return pairs.size() + vectors.size() + strings.size();
+}
+
+
+void Op::pooled_cons()
+{
+    Object obj = LiteralPool::find_pair(VM::peek(1), VM::peek(0));
+    if (obj.undefined()) {
+        obj = Object::Pair(VM::peek(1), VM::peek(0));
+        LiteralPool::insert(obj);
+    }
+    VM::push(obj, 2);
+}
+
+void Op::pooled_vector(std::size_t nelems)
+{
+    const std::vector<Object>& stack = VM::frames().front().stack();
+    const Object* elements = nelems > 0 ? &stack[stack.size() - nelems] : nullptr;
+    Object obj = LiteralPool::find_vector(elements, nelems);
+    if (obj.undefined()) {
+        obj = Object::Vector(nelems);
+        for (std::size_t i = 0; i < nelems; i++)
+            obj[i] = VM::peek(nelems - i - 1);
+        LiteralPool::insert(obj);
+    }
+    VM::push(obj, nelems);
+}
+
+void Op::pooled_string(std::string_view data)
+{
+    Object obj = LiteralPool::find_string(data);
+    if (obj.undefined()) {
+        obj = Object::String(data);
+        LiteralPool::insert(obj);
+    }
+    VM::push(obj);
+}
@@ -0,0 +1,42 @@
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include "object.h"
+
+
+#ifndef POOL_H
+#define POOL_H
+
+
+// Hash-consing pool for immutable literals. Pairs and vectors are keyed by
+// the words of their (already pooled) elements, so identical subtrees map
+// to one object in constant time per node. Entries are weak: the collector
+// drops the ones it did not mark. The Op::pooled_* constructors use this.
+class LiteralPool
+{
+public:
+    static Object find_pair(Object car, Object cdr);
+    static Object find_vector(const Object* elements, std::size_t nelems);
+    static Object find_string(std::string_view data);
+    static void insert(Object obj);
+
+    static void sweep();
+    static void clear();
+    static std::size_t size();
+
+private:
+    struct PairHash {
+        std::size_t operator()(const std::pair<uint64_t, uint64_t>& key) const;
+    };
+
+    static std::unordered_map<std::pair<uint64_t, uint64_t>, Object, PairHash> pairs;
+
+    // Keys view the payload of the pooled object itself, which never
+    // changes since pooled objects are immutable
+    static std::unordered_map<std::string_view, Object> vectors;
+    static std::unordered_map<std::string_view, Object> strings;
+};
+
+
+#endif /* POOL_H */
@@ -0,0 +1,320 @@
+#include <charconv>
+#include <type_traits>
+
+#include "charclass.h"
+#include "number.h"
+#include "numvector.h"
+#include "object.h"
+#include "simd.h"
+#include "utf8.h"
+
+#include "print.h"
+
+
+static inline bool compound(Object obj)
+{
+    if (obj.immediate())
+        return false;
+    Type tp = obj.type();
+    return tp == Type::Pair || tp == Type::Vector || tp == Type::Error;
+}
+
+void Printer::flush()
+{
+    if (!sink)
+        return;
+    sink->write(buffer.data(), buffer.size());
+    buffer.clear();
+}
+
+// Depth-first pre-pass over compound objects. An object reached again
+// while it is still being visited lies on a cycle; one reached again after
+// it was visited is shared.
+void Printer::find_labels(Object root)
+{
+    label_ids.clear();
+    next_label = 0;
+    if (labels == Labels::None)
+        return;
+
+    enum class State { Active, Done };
+    std::unordered_map<uint64_t, State> state;
+    std::vector<std::pair<Object, bool>> pending;
+    pending.emplace_back(root, false);
+
+    while (!pending.empty()) {
+        const Object obj = pending.back().first;
+        bool leaving = pending.back().second;
+        pending.pop_back();
+
+        if (leaving) {
+            state[obj.view()] = State::Done;
+            continue;
+        }
+        if (!compound(obj))
+            continue;
+
+        auto found = state.emplace(obj.view(), State::Active);
+        if (!found.second) {
+            if (found.first->second == State::Active || labels == Labels::Shared)
+                label_ids[obj.view()] = -1;
+            continue;
+        }
+
+        pending.emplace_back(obj, true);
+        switch (obj.type()) {
+        case Type::Pair:
+            pending.emplace_back(obj.cdr(), false);
+            pending.emplace_back(obj.car(), false);
+            break;
+        case Type::Vector:
+            for (std::size_t i = obj.size(); i > 0; i--)
+                pending.emplace_back(obj[i-1], false);
+            break;
+        default:
+            pending.emplace_back(obj.payload(), false);
+            pending.emplace_back(obj.signal(), false);
+        }
+    }
+}
+
+// Write the label of obj if it has one, returning true if that was a
+// back-reference and the object itself should not be printed
+bool Printer::print_label(Object obj)
+{
+    if (label_ids.empty())
+        return false;
+    auto it = label_ids.find(obj.view());
+    if (it == label_ids.end())
+        return false;
+
+    bool seen = it->second >= 0;
+    if (!seen)
+        it->second = next_label++;
+    buffer.push_back('#');
+    print_number(it->second);
+    buffer.push_back(seen ? '#' : '=');
+    return seen;
+}
+
+template <typename T> void Printer::print_number(T value)
+{
+    if constexpr (std::is_floating_point<T>::value)
+        buffer += flonum_to_string(value);
+    else {
+        char digits[24];
+        buffer.append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr);
+    }
+}
+
+// Append the body of a string literal, without the quotes
+void Printer::print_escaped(std::string_view text)
+{
+    const char* pos = text.data();
+    const char* end = pos + text.size();
+
+    while (pos < end) {
+        const char* special = simd_find_escape(pos, end);
+        buffer.append(pos, special - pos);
+        if (special == end)
+            break;
+        switch (*special) {
+        case '\n': buffer += "\\n"; break;
+        case '\t': buffer += "\\t"; break;
+        default:
+            buffer.push_back('\\');
+            buffer.push_back(*special);
+        }
+        pos = special + 1;
+    }
+}
+
+// Characters are written so that the reader gives them back, by name or
+// in hex if they would otherwise be invisible
+void Printer::print_character(char32_t c)
+{
+    buffer += "#\\";
+    if (const char* name = char_name(c))
+        buffer += name;
+    else if (c < ' ' || c == 0x7f) {
+        char buf[8];
+        buffer.push_back('x');
+        buffer.append(buf, std::to_chars(buf, buf + sizeof(buf), (uint32_t)c, 16).ptr);
+    }
+    else
+        utf8_encode(buffer, c);
+}
+
+void Printer::print_object(Object obj)
+{
+    switch (obj.type()) {
+    case Type::Fixnum: print_number(obj.fixnum()); break;
+    case Type::Bignum: buffer += integer_to_string(obj); break;
+    case Type::Flonum: print_number(obj.flonum()); break;
+    case Type::Character: print_character(obj.character()); break;
+    case Type::False: buffer += "#f"; break;
+    case Type::True: buffer += "#t"; break;
+    case Type::EmptyList: buffer += "()"; break;
+    case Type::Undefined: buffer += "#<undefined>"; break;
+    case Type::Symbol: buffer += obj.text(); break;
+    case Type::String:
+        buffer.push_back('"');
+        print_escaped(obj.text());
+        buffer.push_back('"');
+        break;
+    case Type::StringBuilder:
+        buffer.push_back('"');
+        obj.builder_pieces([&] (std::string_view piece) { print_escaped(piece); });
+        buffer.push_back('"');
+        break;
+    case Type::Table:
+        buffer += "#<table ";
+        print_number(obj.table_count());
+        buffer.push_back('>');
+        break;
+    case Type::RecordType:
+        buffer += "#<record-type ";
+        buffer += obj.record_name().text();
+        buffer.push_back('>');
+        break;
+    case Type::Record:
+        buffer += "#<";
+        buffer += obj.record_type().record_name().text();
+        buffer.push_back('>');
+        break;
+    case Type::Bytevector:
+        buffer += "#u8(";
+        for (std::size_t i = 0; i < obj.nbytes(); i++) {
+            if (i > 0)
+                buffer.push_back(' ');
+            print_number(obj.bytes()[i]);
+        }
+        buffer.push_back(')');
+        break;
+    case Type::NumVector:
+        buffer.push_back('#');
+        buffer += numeric_tag(obj.numeric());
+        buffer.push_back('(');
+        numeric_dispatch(obj.numeric(), [&] (auto elt) {
+            typedef decltype(elt) T;
+            for (std::size_t i = 0; i < obj.length(); i++) {
+                if (i > 0)
+                    buffer.push_back(' ');
+                print_number(obj.elements<T>()[i]);
+            }
+        });
+        buffer.push_back(')');
+        break;
+
+    // Compound objects schedule their parts on the stack, last part first
+    case Type::Pair:
+        if (print_label(obj))
+            break;
+        buffer.push_back('(');
+        stack.push_back({ Task::ListRest, obj.cdr(), 0, nullptr });
+        stack.push_back({ Task::Print, obj.car(), 0, nullptr });
+        break;
+    case Type::Vector:
+        if (print_label(obj))
+            break;
+        buffer += "#(";
+        stack.push_back({ Task::VectorRest, obj, 0, nullptr });
+        break;
+    case Type::Error:
+        if (print_label(obj))
+            break;
+        buffer += "#<error ";
+        stack.push_back({ Task::Text, obj, 0, ">" });
+        stack.push_back({ Task::Print, obj.payload(), 0, nullptr });
+        stack.push_back({ Task::Text, obj, 0, " " });
+        stack.push_back({ Task::Print, obj.signal(), 0, nullptr });
+        break;
+    }
+}
+
+void Printer::print(Object root)
+{
+    find_labels(root);
+    stack.push_back({ Task::Print, root, 0, nullptr });
+
+    while (!stack.empty()) {
+        const Step step = stack.back();
+        stack.pop_back();
+
+        switch (step.task) {
+        case Task::Print:
+            print_object(step.obj);
+            break;
+        case Task::Text:
+            buffer += step.text;
+            break;
+        case Task::ListRest: {
+            // Continue a list from its tail; labelled tails must be
+            // written in dotted form to carry the label
+            Object tail = step.obj;
+            if (tail == Object::EmptyList)
+                buffer.push_back(')');
+            else if (tail.type() == Type::Pair && !label_ids.count(tail.view())) {
+                buffer.push_back(' ');
+                stack.push_back({ Task::ListRest, tail.cdr(), 0, nullptr });
+                stack.push_back({ Task::Print, tail.car(), 0, nullptr });
+            }
+            else {
+                buffer += " . ";
+                stack.push_back({ Task::Text, tail, 0, ")" });
+                stack.push_back({ Task::Print, tail, 0, nullptr });
+            }
+            break;
+        }
+        case Task::VectorRest:
+            if (step.idx == step.obj.size()) {
+                buffer.push_back(')');
+                break;
+            }
+            if (step.idx > 0)
+                buffer.push_back(' ');
+            stack.push_back({ Task::VectorRest, step.obj, step.idx + 1, nullptr });
+            stack.push_back({ Task::Print, step.obj[step.idx], 0, nullptr });
+            break;
+        }
+
+        if (sink && buffer.size() >= PRINT_FLUSH_SIZE)
+            flush();
+    }
+}
+
+void Printer::display(Object obj)
+{
+    switch (obj.type()) {
+    case Type::String:
+        buffer += obj.text();
+        break;
+    case Type::StringBuilder:
+        // Large builders go to the sink piece by piece, without flattening
+        obj.builder_pieces([&] (std::string_view piece) {
+            if (sink && buffer.size() + piece.size() >= PRINT_FLUSH_SIZE) {
+                flush();
+                sink->write(piece.data(), piece.size());
+            }
+            else
+                buffer += piece;
+        });
+        break;
+    case Type::Character:
+        utf8_encode(buffer, obj.character());
+        break;
+    default:
+        print(obj);
+        return;
+    }
+
+    if (sink && buffer.size() >= PRINT_FLUSH_SIZE)
+        flush();
+}
+
+std::ostream& operator<<(std::ostream& out, Object obj)
+{
+    Printer printer(out);
+    printer.print(obj);
+    return out;
+}
@@ -0,0 +1,70 @@
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "object.h"
+
+
+#ifndef PRINT_H
+#define PRINT_H
+
+
+// Output is handed to the sink stream in chunks of about this size
+#define PRINT_FLUSH_SIZE 65536
+
+// Which objects get #n= and #n# datum labels
+enum class Labels {
+    None,                       // No labels; loops forever on cycles
+    Cycles,                     // Only where needed to break cycles
+    Shared                      // Every object reachable more than once
+};
+
+// Writes objects into a growable byte buffer, walking structure with an
+// explicit stack so that depth is only limited by memory. With a sink,
+// the buffer is flushed to it when full and on destruction.
+class Printer
+{
+public:
+    Printer(Labels labels = Labels::Cycles) : labels(labels), sink(nullptr) { }
+    Printer(std::ostream& sink, Labels labels = Labels::Cycles) : labels(labels), sink(&sink) { }
+    ~Printer() { flush(); }
+
+    void print(Object obj);
+    void flush();
+
+    // Write strings, string builders and characters as their raw
+    // contents rather than as literals; anything else is printed
+    void display(Object obj);
+
+    inline const std::string& str() const { return buffer; }
+
+private:
+    enum class Task { Print, Text, ListRest, VectorRest };
+
+    struct Step {
+        Task task;
+        Object obj;
+        std::size_t idx;
+        const char* text;
+    };
+
+    void find_labels(Object root);
+    bool print_label(Object obj);
+    void print_object(Object obj);
+    void print_escaped(std::string_view text);
+    void print_character(char32_t c);
+    template <typename T> void print_number(T value);
+
+    Labels labels;
+    std::ostream* sink;
+    std::string buffer;
+    std::vector<Step> stack;
+
+    // Label number of each labelled object, or -1 before it is first printed
+    std::unordered_map<uint64_t, int64_t> label_ids;
+    int64_t next_label;
+};
+
+
+#endif /* PRINT_H */
@@ -0,0 +1,102 @@
+#include "gc.h"
+#include "object.h"
+#include "vm.h"
+
+
+Object Object::RecordType(Object name, Object fields)
+{
+    Object obj = GC::alloc<RecordType_>();
+    obj.set_type(Type::RecordType);
+    obj.deref<RecordType_>()->name = name;
+    obj.deref<RecordType_>()->fields = fields;
+    return obj;
+}
+
+Object Object::Record(Object rtd)
+{
+    return Object::Record(rtd, rtd.record_fields().size());
+}
+
+// An instance with nslots slots, for callers that fill in its type later
+Object Object::Record(Object rtd, std::size_t nslots)
+{
+    Object obj = GC::alloc<Record_>(nslots * sizeof(Object));
+    obj.set_type(Type::Record);
+    Record_* rec = obj.deref<Record_>();
+    rec->rtd = rtd;
+    rec->nslots = nslots;
+    for (std::size_t i = 0; i < nslots; i++)
+        new (rec->slots() + i) Object(Object::Undefined);
+    return obj;
+}
+
+// Index of the named field, or the number of fields if there is none
+std::size_t Object::field_index(Object name) const
+{
+    const Object fields = record_fields();
+    std::size_t idx = 0;
+    while (idx < fields.size() && fields[idx] != name)
+        idx++;
+    return idx;
+}
+
+
+Object VM::RecordType(const std::string& name, const std::vector<std::string>& fields)
+{
+    Op::intern(name);
+    for (const std::string& field : fields)
+        Op::intern(field);
+    Op::record_type(fields.size());
+    return peek();
+}
+
+// Replace a name and nfields field names with a new record type
+void Op::record_type(std::size_t nfields)
+{
+    for (std::size_t i = 0; i <= nfields; i++)
+        CHECK_ARGS(VM::peek(i).type() == Type::Symbol,
+                   nfields + 1, type, "record-type: names must be symbols");
+
+    Op::vector(nfields);
+    VM::push(Object::RecordType(VM::peek(1), VM::peek(0)), 2);
+}
+
+// Replace a record type and the values of its fields with a new instance
+void Op::record(std::size_t nfields)
+{
+    Object rtd = VM::peek(nfields);
+    CHECK_ARGS(rtd.type() == Type::RecordType && rtd.record_fields().size() == nfields,
+          nfields + 1, type, "record: wrong number of fields");
+
+    Object obj = Object::Record(rtd);
+    for (std::size_t i = 0; i < nfields; i++)
+        obj.slots()[i] = VM::peek(nfields - i - 1);
+    VM::push(obj, nfields + 1);
+}
+
+void Op::record_p(Object rtd)
+{
+    Object obj = VM::peek();
+    bool result = obj.type() == Type::Record && obj.record_type() == rtd;
+    VM::push(result ? Object::True : Object::False, 1);
+}
+
+void Op::record_ref(Object rtd, std::size_t idx)
+{
+    Object obj = VM::peek();
+    CHECK_ARGS(obj.type() == Type::Record && obj.record_type() == rtd,
+          1, type, "record-ref: not a " + rtd.record_name().string());
+    CHECK_ARGS(idx < obj.nslots(), 1, range, "record-ref: no such field");
+    VM::push(obj.slots()[idx], 1);
+}
+
+// Store the value on top of the stack in the record below it, leaving
+// the record
+void Op::record_set(Object rtd, std::size_t idx)
+{
+    Object obj = VM::peek(1);
+    CHECK_ARGS(obj.type() == Type::Record && obj.record_type() == rtd,
+          2, type, "record-set!: not a " + rtd.record_name().string());
+    CHECK_ARGS(idx < obj.nslots(), 2, range, "record-set!: no such field");
+    obj.slots()[idx] = VM::pop();
+}
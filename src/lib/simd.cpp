@@ -0,0 +1,295 @@
+#include <cstring>
+#include <initializer_list>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// AVX2 code is compiled separately and only called after a run-time check
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SIMD_AVX2
+#include <immintrin.h>
+#endif
+
+#include "charclass.h"
+#include "simd.h"
+
+
+const uint8_t* simd_search(const uint8_t* begin, const uint8_t* end,
+                           const uint8_t* needle, std::size_t n)
+{
+    if (n == 0)
+        return begin;
+    if ((std::size_t)(end - begin) < n)
+        return end;
+    if (n == 1) {
+        const void* found = std::memchr(begin, needle[0], end - begin);
+        return found ? (const uint8_t*)found : end;
+    }
+
+    // Candidate starting positions are [begin, stop)
+    const uint8_t* stop = end - n + 1;
+    const uint8_t* pos = begin;
+
+#ifdef __SSE2__
+    // Compare the first and last needle bytes against 16 candidates at a
+    // time, and only run a full comparison where both match
+    __m128i first = _mm_set1_epi8((char)needle[0]);
+    __m128i last = _mm_set1_epi8((char)needle[n-1]);
+    for (; pos + 16 <= stop; pos += 16) {
+        __m128i head = _mm_loadu_si128((const __m128i*)pos);
+        __m128i tail = _mm_loadu_si128((const __m128i*)(pos + n - 1));
+        unsigned mask = _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last)));
+        for (; mask; mask &= mask - 1) {
+            const uint8_t* cand = pos + __builtin_ctz(mask);
+            if (std::memcmp(cand + 1, needle + 1, n - 2) == 0)
+                return cand;
+        }
+    }
+#endif
+
+    for (; pos < stop; pos++)
+        if (pos[0] == needle[0] && pos[n-1] == needle[n-1] &&
+            std::memcmp(pos + 1, needle + 1, n - 2) == 0)
+            return pos;
+    return end;
+}
+
+static inline bool needs_escape(char c)
+{
+    return c == '"' || c == '\\' || c == '\n' || c == '\t';
+}
+
+const char* simd_find_escape(const char* begin, const char* end)
+{
+    const char* pos = begin;
+
+#ifdef __SSE2__
+    __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\');
+    __m128i newline = _mm_set1_epi8('\n'), tab = _mm_set1_epi8('\t');
+    for (; pos + 16 <= end; pos += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)pos);
+        __m128i hits = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, tab)));
+        unsigned mask = _mm_movemask_epi8(hits);
+        if (mask)
+            return pos + __builtin_ctz(mask);
+    }
+#endif
+
+    for (; pos < end; pos++)
+        if (needs_escape(*pos))
+            return pos;
+    return end;
+}
+
+
+// The lexer's byte classes for the scalar tails (see charclass.h)
+static inline bool delimiter(unsigned char c)
+{
+    return char_is(c, CHAR_DELIMITER);
+}
+
+static inline bool quote(unsigned char c)
+{
+    return char_is(c, CHAR_QUOTE);
+}
+
+static inline bool nonspace(unsigned char c)
+{
+    return !char_is(c, CHAR_SPACE);
+}
+
+static inline bool block(unsigned char c)
+{
+    return char_is(c, CHAR_BLOCK);
+}
+
+static inline bool structural(unsigned char c)
+{
+    return char_is(c, CHAR_STRUCTURAL);
+}
+
+template <bool (*match)(unsigned char)>
+static inline const char* scan(const char* pos, const char* end)
+{
+    for (; pos < end; pos++)
+        if (match(*pos))
+            return pos;
+    return end;
+}
+
+// Each class is defined once for scalars and once as a function of a
+// vector of bytes, giving a vector with all bits set where a byte is in
+// the class; SCANNER turns the pair into a search of a given width
+#define SCANNER(name, width, vec, load, movemask, classify, scalar)     \
+    static const char* name(const char* begin, const char* end)         \
+    {                                                                   \
+        const char* pos = begin;                                        \
+        for (; pos + width <= end; pos += width) {                      \
+            uint32_t mask = (uint32_t)movemask(classify(load((const vec*)pos))); \
+            if (mask)                                                   \
+                return pos + __builtin_ctz(mask);                       \
+        }                                                               \
+        return scan<scalar>(pos, end);                                  \
+    }
+
+#ifdef __SSE2__
+static inline __m128i space_sse2(__m128i c)
+{
+    // Bytes 9 to 13 are those below -123 after biasing by 128 - 9
+    __m128i control = _mm_cmplt_epi8(_mm_add_epi8(c, _mm_set1_epi8(0x77)), _mm_set1_epi8(-123));
+    return _mm_or_si128(control, _mm_cmpeq_epi8(c, _mm_set1_epi8(' ')));
+}
+
+static inline __m128i delimiter_sse2(__m128i c)
+{
+    __m128i hits = space_sse2(c);
+    for (char d : { '(', ')', '[', ']', '"', ',', '`', '\'', ';' })
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(c, _mm_set1_epi8(d)));
+    return hits;
+}
+
+static inline __m128i quote_sse2(__m128i c)
+{
+    return _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('"')),
+                        _mm_cmpeq_epi8(c, _mm_set1_epi8('\\')));
+}
+
+static inline __m128i nonspace_sse2(__m128i c)
+{
+    return _mm_xor_si128(space_sse2(c), _mm_set1_epi8(-1));
+}
+
+static inline __m128i block_sse2(__m128i c)
+{
+    return _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('|')),
+                        _mm_cmpeq_epi8(c, _mm_set1_epi8('#')));
+}
+
+static inline __m128i structural_sse2(__m128i c)
+{
+    __m128i hits = _mm_setzero_si128();
+    for (char d : { '(', ')', '[', ']', '"', ';', '#' })
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(c, _mm_set1_epi8(d)));
+    return hits;
+}
+
+SCANNER(find_delimiter_sse2, 16, __m128i, _mm_loadu_si128, _mm_movemask_epi8, delimiter_sse2, delimiter)
+SCANNER(find_quote_sse2, 16, __m128i, _mm_loadu_si128, _mm_movemask_epi8, quote_sse2, quote)
+SCANNER(skip_space_sse2, 16, __m128i, _mm_loadu_si128, _mm_movemask_epi8, nonspace_sse2, nonspace)
+SCANNER(find_block_sse2, 16, __m128i, _mm_loadu_si128, _mm_movemask_epi8, block_sse2, block)
+SCANNER(find_structural_sse2, 16, __m128i, _mm_loadu_si128, _mm_movemask_epi8, structural_sse2, structural)
+#else
+#define find_delimiter_sse2 scan<delimiter>
+#define find_quote_sse2 scan<quote>
+#define skip_space_sse2 scan<nonspace>
+#define find_block_sse2 scan<block>
+#define find_structural_sse2 scan<structural>
+#endif
+
+#ifdef SIMD_AVX2
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256i space_avx2(__m256i c)
+{
+    __m256i control = _mm256_cmpgt_epi8(_mm256_set1_epi8(-123), _mm256_add_epi8(c, _mm256_set1_epi8(0x77)));
+    return _mm256_or_si256(control, _mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')));
+}
+
+AVX2 static inline __m256i delimiter_avx2(__m256i c)
+{
+    __m256i hits = space_avx2(c);
+    for (char d : { '(', ')', '[', ']', '"', ',', '`', '\'', ';' })
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(c, _mm256_set1_epi8(d)));
+    return hits;
+}
+
+AVX2 static inline __m256i quote_avx2(__m256i c)
+{
+    return _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('"')),
+                           _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\\')));
+}
+
+AVX2 static inline __m256i nonspace_avx2(__m256i c)
+{
+    return _mm256_xor_si256(space_avx2(c), _mm256_set1_epi8(-1));
+}
+
+AVX2 static inline __m256i block_avx2(__m256i c)
+{
+    return _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('|')),
+                           _mm256_cmpeq_epi8(c, _mm256_set1_epi8('#')));
+}
+
+AVX2 static inline __m256i structural_avx2(__m256i c)
+{
+    __m256i hits = _mm256_setzero_si256();
+    for (char d : { '(', ')', '[', ']', '"', ';', '#' })
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(c, _mm256_set1_epi8(d)));
+    return hits;
+}
+
+AVX2 SCANNER(find_delimiter_avx2, 32, __m256i, _mm256_loadu_si256, _mm256_movemask_epi8, delimiter_avx2, delimiter)
+AVX2 SCANNER(find_quote_avx2, 32, __m256i, _mm256_loadu_si256, _mm256_movemask_epi8, quote_avx2, quote)
+AVX2 SCANNER(skip_space_avx2, 32, __m256i, _mm256_loadu_si256, _mm256_movemask_epi8, nonspace_avx2, nonspace)
+AVX2 SCANNER(find_block_avx2, 32, __m256i, _mm256_loadu_si256, _mm256_movemask_epi8, block_avx2, block)
+AVX2 SCANNER(find_structural_avx2, 32, __m256i, _mm256_loadu_si256, _mm256_movemask_epi8, structural_avx2, structural)
+#endif
+
+typedef const char* (*Scanner)(const char*, const char*);
+
+struct Scanners {
+    Scanner find_delimiter;
+    Scanner find_quote;
+    Scanner skip_space;
+    Scanner find_block;
+    Scanner find_structural;
+};
+
+static Scanners select_scanners()
+{
+#ifdef SIMD_AVX2
+    if (__builtin_cpu_supports("avx2"))
+        return { find_delimiter_avx2, find_quote_avx2, skip_space_avx2, find_block_avx2,
+                 find_structural_avx2 };
+#endif
+    return { find_delimiter_sse2, find_quote_sse2, skip_space_sse2, find_block_sse2,
+             find_structural_sse2 };
+}
+
+static const Scanners scanners = select_scanners();
+
+const char* simd_find_delimiter(const char* begin, const char* end)
+{
+    return scanners.find_delimiter(begin, end);
+}
+
+const char* simd_find_quote(const char* begin, const char* end)
+{
+    return scanners.find_quote(begin, end);
+}
+
+const char* simd_skip_space(const char* begin, const char* end)
+{
+    return scanners.skip_space(begin, end);
+}
+
+const char* simd_find_block(const char* begin, const char* end)
+{
+    return scanners.find_block(begin, end);
+}
+
+const char* simd_find_structural(const char* begin, const char* end)
+{
+    return scanners.find_structural(begin, end);
+}
+
+// glibc's memchr is already vectorised
+const char* simd_find_newline(const char* begin, const char* end)
+{
+    const void* found = std::memchr(begin, '\n', end - begin);
+    return found ? (const char*)found : end;
+}
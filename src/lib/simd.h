@@ -0,0 +1,43 @@
+#include <cstddef>
+#include <stdint.h>
+
+
+#ifndef SIMD_H
+#define SIMD_H
+
+
+// Find the first occurrence of the n-byte needle in [begin, end), or
+// return end if there is none
+const uint8_t* simd_search(const uint8_t* begin, const uint8_t* end,
+                           const uint8_t* needle, std::size_t n);
+
+// Find the first byte in [begin, end) that must be escaped in a string
+// literal (double quote, backslash, newline or tab), or return end
+const char* simd_find_escape(const char* begin, const char* end);
+
+// Lexer scanners, each returning the first byte in [begin, end) of the
+// given kind or end. These pick an AVX2 or SSE2 implementation at run
+// time, according to what the processor supports.
+
+// Whitespace, parentheses, brackets, double quote, quote characters or
+// semicolon, which end identifiers
+const char* simd_find_delimiter(const char* begin, const char* end);
+
+// Double quote or backslash, which interrupt string literals
+const char* simd_find_quote(const char* begin, const char* end);
+
+// Anything but whitespace
+const char* simd_skip_space(const char* begin, const char* end);
+
+// Vertical bar or hash, which may close or open a nested block comment
+const char* simd_find_block(const char* begin, const char* end);
+
+// Parentheses, brackets, double quote, semicolon or hash, which start or
+// end nested data, strings and comments
+const char* simd_find_structural(const char* begin, const char* end);
+
+// Newline, which ends a line comment
+const char* simd_find_newline(const char* begin, const char* end);
+
+
+#endif /* SIMD_H */
@@ -0,0 +1,131 @@
+#include <utility>
+
+#include "gc.h"
+#include "hash.h"
+#include "object.h"
+#include "vm.h"
+
+
+// Grow once the table would be more than 7/8 full; Robin Hood probing
+// keeps probe sequences short even at this load
+#define TABLE_MIN_SLOTS 8
+#define TABLE_LOAD_NUM 7
+#define TABLE_LOAD_DEN 8
+
+
+// Place a slot known not to be in the table yet, displacing residents
+// that are closer to their home slot than the incoming one
+static void place(std::vector<TableSlot>& slots, TableSlot entry)
+{
+    std::size_t mask = slots.size() - 1;
+    entry.distance = 1;
+    for (std::size_t i = entry.hash & mask; ; i = (i + 1) & mask, entry.distance++) {
+        TableSlot& slot = slots[i];
+        if (slot.distance == 0) {
+            slot = entry;
+            return;
+        }
+        if (slot.distance < entry.distance)
+            std::swap(slot, entry);
+    }
+}
+
+static void grow(Table_* table)
+{
+    std::vector<TableSlot> slots(std::max<std::size_t>(TABLE_MIN_SLOTS, 2 * table->slots.size()));
+    for (const TableSlot& slot : table->slots)
+        if (slot.distance > 0)
+            place(slots, slot);
+    table->slots.swap(slots);
+}
+
+// String tables hash and compare the text of their keys, so only
+// strings can be keys
+static inline bool valid_key(const Table_* table, Object key)
+{
+    return table->kind != Equivalence::String || key.type() == Type::String;
+}
+
+// Index of the slot holding key, or the number of slots if it is absent
+static std::size_t find(const Table_* table, Object key, uint32_t h)
+{
+    const std::vector<TableSlot>& slots = table->slots;
+    if (table->count == 0)
+        return slots.size();
+
+    std::size_t mask = slots.size() - 1;
+    for (std::size_t i = h & mask, distance = 1; ; i = (i + 1) & mask, distance++) {
+        const TableSlot& slot = slots[i];
+        // Every resident from here on is closer to home than key would be
+        if (slot.distance < distance)
+            return slots.size();
+        if (slot.hash == h && equivalent(table->kind, slot.key, key))
+            return i;
+    }
+}
+
+
+Object Object::Table(Equivalence kind)
+{
+    Object obj = GC::alloc<Table_>();
+    obj.set_type(Type::Table);
+    obj.deref<Table_>()->kind = kind;
+    obj.deref<Table_>()->count = 0;
+    return obj;
+}
+
+Object Object::table_ref(Object key, Object fallback) const
+{
+    const Table_* table = deref<Table_>();
+    if (!valid_key(table, key))
+        return fallback;
+    std::size_t idx = find(table, key, (uint32_t)hash(table->kind, key));
+    return idx < table->slots.size() ? table->slots[idx].value : fallback;
+}
+
+void Object::table_set(Object key, Object value)
+{
+    Table_* table = deref<Table_>();
+    OBJECT_CHECK(valid_key(table, key));
+    uint32_t h = (uint32_t)hash(table->kind, key);
+    std::size_t idx = find(table, key, h);
+    if (idx < table->slots.size()) {
+        table->slots[idx].value = value;
+        return;
+    }
+
+    if ((table->count + 1) * TABLE_LOAD_DEN > table->slots.size() * TABLE_LOAD_NUM)
+        grow(table);
+    place(table->slots, TableSlot { key, value, h, 0 });
+    table->count++;
+}
+
+bool Object::table_delete(Object key)
+{
+    Table_* table = deref<Table_>();
+    std::vector<TableSlot>& slots = table->slots;
+    if (!valid_key(table, key))
+        return false;
+    std::size_t idx = find(table, key, (uint32_t)hash(table->kind, key));
+    if (idx == slots.size())
+        return false;
+
+    // Shift the following run of displaced slots back by one
+    std::size_t mask = slots.size() - 1;
+    for (std::size_t next = (idx + 1) & mask; slots[next].distance > 1;
+         idx = next, next = (next + 1) & mask) {
+        slots[idx] = slots[next];
+        slots[idx].distance--;
+    }
+    slots[idx] = TableSlot { Object::Undefined, Object::Undefined, 0, 0 };
+    table->count--;
+    return true;
+}
+
+
+Object VM::Table(Equivalence kind)
+{
+    Object ret = Object::Table(kind);
+    push(ret);
+    return ret;
+}
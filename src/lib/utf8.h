@@ -0,0 +1,60 @@
+#include <string>
+#include <stdint.h>
+
+
+#ifndef UTF8_H
+#define UTF8_H
+
+
+#define UTF8_REPLACEMENT 0xfffd
+
+inline bool utf8_continuation(unsigned char c) { return (c & 0xc0) == 0x80; }
+
+// Append the UTF-8 encoding of a code point
+inline void utf8_encode(std::string& out, char32_t cp)
+{
+    if (cp < 0x80)
+        out.push_back((char)cp);
+    else if (cp < 0x800) {
+        out.push_back((char)(0xc0 | (cp >> 6)));
+        out.push_back((char)(0x80 | (cp & 0x3f)));
+    }
+    else if (cp < 0x10000) {
+        out.push_back((char)(0xe0 | (cp >> 12)));
+        out.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+        out.push_back((char)(0x80 | (cp & 0x3f)));
+    }
+    else if (cp < 0x110000) {
+        out.push_back((char)(0xf0 | (cp >> 18)));
+        out.push_back((char)(0x80 | ((cp >> 12) & 0x3f)));
+        out.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+        out.push_back((char)(0x80 | (cp & 0x3f)));
+    }
+    else
+        utf8_encode(out, UTF8_REPLACEMENT);
+}
+
+// Decode one code point starting at *pos and advance past it. Malformed
+// sequences decode as U+FFFD, consuming one byte.
+inline char32_t utf8_decode(const char*& pos, const char* end)
+{
+    unsigned char c = *pos++;
+    if (c < 0x80)
+        return c;
+
+    std::size_t extra = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : 0;
+    if (extra == 0 || c > 0xf4 || (std::size_t)(end - pos) < extra)
+        return UTF8_REPLACEMENT;
+
+    char32_t cp = c & (0x3f >> extra);
+    for (std::size_t i = 0; i < extra; i++) {
+        if (!utf8_continuation(pos[i]))
+            return UTF8_REPLACEMENT;
+        cp = (cp << 6) | (pos[i] & 0x3f);
+    }
+    pos += extra;
+    return cp;
+}
+
+
+#endif /* UTF8_H */
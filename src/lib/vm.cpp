@@ -6,32 +6,42 @@
 #include "vm.h"
 
 
-std::list<Frame> VM::_frames;
-Object VM::_error;
+VMState VM::_main;
+__thread VMState* VM::_state = &VM::_main;
 
 Frame& VM::push_frame()
 {
     Frame frame;
-    _frames.push_front(frame);
-    return _frames.front();
+    _state->frames.push_front(frame);
+    return _state->frames.front();
 }
 
 void VM::pop_frame()
 {
-    _frames.pop_front();
+    _state->frames.pop_front();
+    _state->nvalues = 1;
+}
+
+// Pop the current frame, moving its top nvalues items onto the one below
+void VM::pop_frame(std::size_t nvalues)
+{
+    Frame& callee = _state->frames.front();
+    std::next(_state->frames.begin())->take(callee, nvalues);
+    _state->frames.pop_front();
+    _state->nvalues = nvalues;
 }
 
 Object VM::String(const std::string& data)
 {
     Object ret = Object::String(data);
-    _frames.front().push(ret);
+    _state->frames.front().push(ret);
     return ret;
 }
 
 Object VM::Pair(Object car, Object cdr)
 {
     Object ret = Object::Pair(car, cdr);
-    _frames.front().push(ret);
+    _state->frames.front().push(ret);
     return ret;
 }
 
@@ -42,7 +52,7 @@ Object VM::List(const std::vector<Object>& elements)
     Object head = Object::EmptyList;
     for (auto i = elements.rbegin(); i != elements.rend(); i++)
         head = Object::Pair(*i, head);
-    _frames.front().push(head);
+    _state->frames.front().push(head);
 
     GC::allow();
     return head;
@@ -53,22 +63,48 @@ Object VM::Vector(const std::vector<Object>& elements)
     Object ret = Object::Vector(elements.size());
     for (std::size_t i = 0; i < elements.size(); i++)
         ret[i] = elements[i];
-    _frames.front().push(ret);
+    _state->frames.front().push(ret);
     return ret;
 }
 
-void Op::intern(const std::string& name)
+void Op::intern(std::string_view name)
 {
     Object obj = Object::Symbol(name);
     VM::push(obj);
 }
 
-void Op::string(const std::string& data)
+void Op::string(std::string_view data)
 {
     Object obj = Object::String(data);
     VM::push(obj);
 }
 
+// Replace a string with its code points [start, end). Long substrings
+// share the bytes of the original instead of copying them.
+void Op::substring(std::size_t start, std::size_t end)
+{
+    Object str = VM::peek();
+    CHECK_ARGS(str.type() == Type::String, 1, type, "substring: not a string");
+    CHECK_ARGS(start <= end && end <= str.string_length(), 1, range, "substring: index out of range");
+
+    // The GC may unshare views, so hold it off while we look at the bytes
+    GC::inhibit();
+    std::size_t from = str.string_offset(start);
+    std::size_t to = str.string_offset(end);
+    Object result;
+    if (to - from < SUBSTRING_SHARE_MIN)
+        result = Object::String(str.text().substr(from, to - from));
+    else if (str.string_parent().undefined())
+        result = Object::Substring(str, from, to, end - start);
+    else {
+        Object parent = str.string_parent();
+        std::size_t base = str.text().data() - parent.text().data();
+        result = Object::Substring(parent, base + from, base + to, end - start);
+    }
+    GC::allow();
+    VM::push(result, 1);
+}
+
 void Op::error()
 {
     Object error = Object::Error(VM::peek(1), VM::peek(0));
@@ -76,11 +112,79 @@ void Op::error()
     VM::pop(2);
 }
 
+// Replace the top nargs operands with Undefined and raise an error
+static void operand_error(std::size_t nargs, const char* signal, const std::string& message)
+{
+    VM::pop(nargs);
+    Op::intern(signal);
+    Op::string(message);
+    Op::error();
+    VM::push(Object::Undefined);
+}
+
+void Op::type_error(std::size_t nargs, const std::string& message)
+{
+    operand_error(nargs, "type", message);
+}
+
+void Op::range_error(std::size_t nargs, const std::string& message)
+{
+    operand_error(nargs, "range", message);
+}
+
 void Op::cons()
 {
     VM::push(Object::Pair(VM::peek(1), VM::peek(0)), 2);
 }
 
+void Op::car()
+{
+    CHECK_ARGS(VM::peek().type() == Type::Pair, 1, type, "car: not a pair");
+    unsafe_car();
+}
+
+void Op::cdr()
+{
+    CHECK_ARGS(VM::peek().type() == Type::Pair, 1, type, "cdr: not a pair");
+    unsafe_cdr();
+}
+
+void Op::set_car()
+{
+    CHECK_ARGS(VM::peek(1).type() == Type::Pair, 2, type, "set-car!: not a pair");
+    CHECK_ARGS(!VM::peek(1).immutable(), 2, type, "set-car!: immutable pair");
+    unsafe_set_car();
+}
+
+void Op::set_cdr()
+{
+    CHECK_ARGS(VM::peek(1).type() == Type::Pair, 2, type, "set-cdr!: not a pair");
+    CHECK_ARGS(!VM::peek(1).immutable(), 2, type, "set-cdr!: immutable pair");
+    unsafe_set_cdr();
+}
+
+void Op::vector_ref(std::size_t idx)
+{
+    CHECK_ARGS(VM::peek().type() == Type::Vector, 1, type, "vector-ref: not a vector");
+    CHECK_ARGS(idx < VM::peek().size(), 1, range, "vector-ref: index out of range");
+    unsafe_vector_ref(idx);
+}
+
+void Op::vector_set(std::size_t idx)
+{
+    CHECK_ARGS(VM::peek(1).type() == Type::Vector, 2, type, "vector-set!: not a vector");
+    CHECK_ARGS(idx < VM::peek(1).size(), 2, range, "vector-set!: index out of range");
+    CHECK_ARGS(!VM::peek(1).immutable(), 2, type, "vector-set!: immutable vector");
+    unsafe_vector_set(idx);
+}
+
+void Op::string_ref(std::size_t idx)
+{
+    CHECK_ARGS(VM::peek().type() == Type::String, 1, type, "string-ref: not a string");
+    CHECK_ARGS(idx < VM::peek().string_length(), 1, range, "string-ref: index out of range");
+    unsafe_string_ref(idx);
+}
+
 void Op::list(std::size_t nelems, bool fix_tail)
 {
     if (fix_tail)
@@ -94,12 +198,26 @@ void Op::vector(std::size_t nelems)
     Object vec = Object::Vector(nelems);
     for (std::size_t i = 0; i < nelems; i++)
         vec[i] = VM::peek(nelems - i - 1);
-    VM::push(vec);
+    VM::push(vec, nelems);
 }
 
 void Op::ret()
 {
-    Object retval = VM::peek();
-    VM::pop_frame();
-    VM::push(retval);
+    // Error paths may return from a frame with nothing on it
+    if (VM::stack_size() == 0)
+        VM::push(Object::Undefined);
+    VM::pop_frame(1);
+}
+
+void Op::ret_values(std::size_t nvalues)
+{
+    // Returning more values than the frame holds is a bug in the caller,
+    // and is raised rather than turned into a single value
+    if (!VM::has_error() && VM::stack_size() < nvalues)
+        Op::range_error(VM::stack_size(), "values: fewer values on the stack than returned");
+    if (VM::has_error()) {
+        Op::ret();
+        return;
+    }
+    VM::pop_frame(nvalues);
 }
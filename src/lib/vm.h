@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <cassert>
+#include <cstdlib>
 #include <iostream>
 #include <vector>
 #include <list>
@@ -15,13 +17,27 @@
 #define RET_IF_ERROR                                                    \
     do { if (VM::has_error()) { Op::ret(); return; } } while (0)
 
+#define ABORT_UNLESS(cond, msg)                                         \
+    do { if (!(cond)) { std::cerr << (msg) << std::endl; std::abort(); } } while (0)
+
 #ifdef DEBUG
-#define ASSERT(cond, msg)                               \
-    if (!(cond)) { std::cerr << (msg) << std::endl; }
+#define ASSERT(cond, msg) ABORT_UNLESS(cond, msg)
 #else
 #define ASSERT(cond, msg) ;
 #endif
 
+// Checked operations validate their operands with CHECK_ARGS, which
+// replaces the top nargs operands with Undefined and raises a Brim error
+// of the given kind (type or range) on failure. Building with
+// BRIM_ASSERT_CHECKS turns these into assertions that abort in every
+// build type, for code that is known to be correct.
+#ifdef BRIM_ASSERT_CHECKS
+#define CHECK_ARGS(cond, nargs, kind, msg) ABORT_UNLESS(cond, msg)
+#else
+#define CHECK_ARGS(cond, nargs, kind, msg)                              \
+    do { if (!(cond)) { Op::kind##_error(nargs, msg); return; } } while (0)
+#endif
+
 
 class Frame
 {
@@ -46,58 +62,172 @@ public:
     inline void pop(std::size_t n) { _stack.erase(_stack.end() - n, _stack.end()); }
     inline void swap() { std::iter_swap(_stack.end() - 1, _stack.end() - 2); }
 
+    // Move the top n items of another frame onto this one, in order
+    inline void take(Frame& from, std::size_t n) {
+        _stack.insert(_stack.end(), from._stack.end() - n, from._stack.end());
+        from.pop(n);
+    }
+
     inline const std::vector<Object>& stack() const { return _stack; }
 };
 
+// The VM's stack of frames, pending error and value count. There is one
+// for the main thread, and one for each worker thread building data in
+// parallel (see parse_parallel).
+struct VMState {
+    std::list<Frame> frames;
+    Object error;
+    std::size_t nvalues = 1;
+};
+
 class VM
 {
 private:
-    static std::list<Frame> _frames;
-    static Object _error;
+    static VMState _main;
+    static __thread VMState* _state __attribute__((tls_model("initial-exec")));
 
 public:
     // Frame manipulation
     static Frame& push_frame();
     static void pop_frame();
-    static inline const std::list<Frame>& frames() { return _frames; }
+    static void pop_frame(std::size_t nvalues);
+    static inline const std::list<Frame>& frames() { return _state->frames; }
+
+    // Switch the calling thread to the given state, or back to the main
+    // thread's if it is null. Every thread starts out on the main thread's
+    // state, so worker threads must switch before using the VM.
+    static inline void use_state(VMState* state) { _state = state ? state : &_main; }
 
     // Raw constructors
     static inline Object Fixnum(int64_t num) { return Object::Fixnum(num); }
-    static inline Object Character(char c) { return Object::Character(c); }
-    static inline Object Intern(const std::string& name) { return Object::Symbol(name); }
+    static Object Integer(int64_t num);
+    static Object Unsigned(uint64_t num);
+    static inline Object Character(char32_t c) { return Object::Character(c); }
+    static inline Object Intern(std::string_view name) { return Object::Symbol(name); }
     static Object String(const std::string& data);
     static Object Pair(Object car, Object cdr);
     static Object List(const std::vector<Object>& elements);
     static Object Vector(const std::vector<Object>& elements);
+    static Object Bytevector(const std::vector<uint8_t>& bytes);
+    static Object Flonum(double value);
+    static Object NumVector(Numeric kind, const void* data, std::size_t nelems);
+    static Object Table(Equivalence kind);
+    static Object RecordType(const std::string& name, const std::vector<std::string>& fields);
+    static Object StringBuilder();
 
     // Frame inspection
-    static inline Object peek() { return _frames.front().peek(); }
-    static inline Object peek(std::size_t index) { return _frames.front().peek(index); }
-    static inline void push(Object obj) { _frames.front().push(obj); }
-    static inline void push(Object obj, std::size_t n) { _frames.front().push(obj, n); }
-    static inline Object pop() { return _frames.front().pop(); }
-    static inline void pop(std::size_t n) { _frames.front().pop(n); }
-    static inline void swap() { _frames.front().swap(); }
-
-    static inline bool has_error() { return _error.defined(); }
-    static inline void set_error(Object error) { _error = error; }
-    static inline Object get_error() { return _error; }
-
-    static inline std::size_t stack_size() { return _frames.front().stack().size(); }
+    static inline Object peek() { return _state->frames.front().peek(); }
+    static inline Object peek(std::size_t index) { return _state->frames.front().peek(index); }
+    static inline void push(Object obj) { _state->frames.front().push(obj); }
+    static inline void push(Object obj, std::size_t n) { _state->frames.front().push(obj, n); }
+    static inline Object pop() { return _state->frames.front().pop(); }
+    static inline void pop(std::size_t n) { _state->frames.front().pop(n); }
+    static inline void swap() { _state->frames.front().swap(); }
+
+    static inline bool has_error() { return _state->error.defined(); }
+    static inline void set_error(Object error) { _state->error = error; }
+    static inline Object get_error() { return _state->error; }
+
+    static inline std::size_t stack_size() { return _state->frames.front().stack().size(); }
+
+    // Number of values left on the stack by the last return
+    static inline std::size_t nvalues() { return _state->nvalues; }
 };
 
 class Op
 {
 public:
-    static void intern(const std::string& name);
-    static void string(const std::string& data);
+    static void intern(std::string_view name);
+    static void string(std::string_view data);
+    static void substring(std::size_t start, std::size_t end);
 
     static void error();
+    static void type_error(std::size_t nargs, const std::string& message);
+    static void range_error(std::size_t nargs, const std::string& message);
     static void cons();
+
+    // Checked accessors. The unsafe_ variants skip all checks, for
+    // callers that have already established the operand types and bounds.
+    // The unsafe_ setters do not check mutability either: pooled data is
+    // keyed by its contents (see pool.h) and must never reach them.
+    static void car();
+    static void cdr();
+    static void set_car();
+    static void set_cdr();
+    static void vector_ref(std::size_t idx);
+    static void vector_set(std::size_t idx);
+    static void string_ref(std::size_t idx);
+
+    static inline void unsafe_car() { VM::push(VM::peek().car(), 1); }
+    static inline void unsafe_cdr() { VM::push(VM::peek().cdr(), 1); }
+    static inline void unsafe_set_car() { VM::peek(1).set_car(VM::pop()); }
+    static inline void unsafe_set_cdr() { VM::peek(1).set_cdr(VM::pop()); }
+    static inline void unsafe_vector_ref(std::size_t idx) {
+        const Object vec = VM::peek();
+        VM::push(vec[idx], 1);
+    }
+    static inline void unsafe_vector_set(std::size_t idx) {
+        Object value = VM::pop();
+        VM::peek()[idx] = value;
+    }
+    static inline void unsafe_string_ref(std::size_t idx) {
+        VM::push(Object::Character(VM::peek().string_ref(idx)), 1);
+    }
     static void list(std::size_t nelems, bool fix_tail = true);
     static void vector(std::size_t nelems);
+    static void bytevector(std::size_t nelems);
+    static void make_bytevector(std::size_t size, uint8_t fill);
+    static void bytevector_copy(std::size_t start, std::size_t end);
+
+    // Homogeneous numeric vectors; integer kinds wrap around on overflow.
+    // u8 vectors are bytevectors, which these accept as kind u8
+    static void numvector_ref(std::size_t idx);
+    static void numvector_set(std::size_t idx);
+    static void numvector_add();
+    static void numvector_sub();
+    static void numvector_mul();
+
+    // Integer arithmetic, promoting to bignums on overflow
+    static void integer(bool negative, std::vector<uint32_t>&& magnitude);
+    static void add();
+    static void sub();
+    static void mul();
+    static void neg();
+
+    // Records. Accessors take the record type and a field index resolved
+    // once with field_index(), so each access is a check and a load.
+    static void record_type(std::size_t nfields);
+    static void record(std::size_t nfields);
+    static void record_p(Object rtd);
+    static void record_ref(Object rtd, std::size_t idx);
+    static void record_set(Object rtd, std::size_t idx);
+
+    // String builders; builder_string replaces the builder with its
+    // contents, and later calls return the same string until it grows
+    static void builder_append();
+    static void builder_string();
 
     static void ret();
+
+    // Multiple values are returned on the caller's stack, last value on
+    // top, with their number in VM::nvalues(), so nothing is allocated.
+    // call_with_values runs producer in a new frame, which it must leave
+    // with ret() or ret_values(), then calls consumer with the count.
+    static void ret_values(std::size_t nvalues);
+    template <typename P, typename C> static void call_with_values(P producer, C consumer) {
+        VM::push_frame();
+        producer();
+        consumer(VM::nvalues());
+    }
+
+    // Hash-consed constructors for immutable literals (see pool.h)
+    static void pooled_cons();
+    static void pooled_vector(std::size_t nelems);
+    static void pooled_string(std::string_view data);
+
+    // Push the object stored in fasl data (see fasl.h)
+    static void fasl_read(const char* data, std::size_t size);
+    static void fasl_load(const std::string& path);
 };
 
 
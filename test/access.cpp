@@ -0,0 +1,97 @@
+#include "catch.h"
+#include "test.h"
+
+#include "object.h"
+#include "vm.h"
+
+
+#ifndef BRIM_ASSERT_CHECKS
+// Return the signal of the pending error and clear it
+static Object take_error()
+{
+    Object signal = VM::has_error() ? VM::get_error().signal() : Object::Undefined;
+    VM::set_error(Object::Undefined);
+    return signal;
+}
+#endif
+
+TEST_CASE("Checked pair accessors", "[access]") {
+    VM::push_frame();
+
+    Object pair = VM::Pair(VM::Fixnum(1), VM::Fixnum(2));
+    Op::car();
+    assert_fixnum(VM::peek(), 1);
+    VM::pop();
+
+    VM::push(pair);
+    VM::push(VM::Fixnum(3));
+    Op::set_cdr();
+    Op::cdr();
+    assert_fixnum(VM::peek(), 3);
+    VM::pop();
+
+#ifndef BRIM_ASSERT_CHECKS
+    VM::push(VM::Fixnum(1));
+    Op::car();
+    REQUIRE(take_error() == VM::Intern("type"));
+    REQUIRE(VM::pop().undefined());
+    REQUIRE(VM::stack_size() == 0);
+#endif
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Checked vector and string accessors", "[access]") {
+    VM::push_frame();
+
+    VM::Vector({VM::Fixnum(1), VM::Fixnum(2)});
+    Op::vector_ref(1);
+    assert_fixnum(VM::peek(), 2);
+    VM::pop();
+
+#ifndef BRIM_ASSERT_CHECKS
+    VM::Vector({VM::Fixnum(1), VM::Fixnum(2)});
+    Op::vector_ref(2);
+    REQUIRE(take_error() == VM::Intern("range"));
+    VM::pop();
+
+    VM::push(Object::EmptyVector);
+    VM::push(VM::Fixnum(0));
+    Op::vector_set(0);
+    REQUIRE(take_error() == VM::Intern("range"));
+    VM::pop();
+#endif
+
+    VM::String("grüße");
+    Op::string_ref(3);
+    assert_character(VM::peek(), U'ß');
+    VM::pop();
+
+#ifndef BRIM_ASSERT_CHECKS
+    VM::String("abc");
+    Op::string_ref(3);
+    REQUIRE(take_error() == VM::Intern("range"));
+    VM::pop();
+
+    VM::push(Object::False);
+    Op::string_ref(0);
+    REQUIRE(take_error() == VM::Intern("type"));
+    VM::pop();
+#endif
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Unsafe accessors", "[access]") {
+    VM::push_frame();
+
+    VM::Pair(VM::Fixnum(1), VM::Vector({VM::Fixnum(2), VM::Fixnum(3)}));
+    Op::unsafe_cdr();
+    VM::push(VM::Fixnum(4));
+    Op::unsafe_vector_set(0);
+    Op::unsafe_vector_ref(0);
+    assert_fixnum(VM::peek(), 4);
+    REQUIRE(!VM::has_error());
+
+    VM::pop_frame();
+}
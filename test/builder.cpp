@@ -0,0 +1,96 @@
+#include <sstream>
+
+#include "catch.h"
+#include "test.h"
+
+#include "gc.h"
+#include "object.h"
+#include "print.h"
+#include "vm.h"
+
+
+TEST_CASE("String builder append and flatten", "[builder]") {
+    VM::push_frame();
+
+    std::string big(100, 'x');
+    std::string expected;
+    Object builder = VM::StringBuilder();
+    for (int i = 0; i < 1000; i++) {
+        std::string piece = i % 100 == 0 ? big : std::to_string(i);
+        VM::String(piece);
+        Op::builder_append();
+        expected += piece;
+    }
+    REQUIRE(VM::peek() == builder);
+    REQUIRE(builder.builder_size() == expected.size());
+    REQUIRE(builder.builder_chunks().size() == 10);
+
+    GC::collect();
+    Op::builder_string();
+    assert_string(VM::peek(), expected);
+    Object str = VM::pop();
+
+    // Flattening again returns the same string
+    VM::push(builder);
+    Op::builder_string();
+    REQUIRE(VM::pop() == str);
+
+    VM::push(builder);
+    VM::String("!");
+    Op::builder_append();
+    Op::builder_string();
+    assert_string(VM::peek(), expected + "!");
+    VM::pop();
+
+#ifndef BRIM_ASSERT_CHECKS
+    VM::push(builder);
+    VM::push(Object::True);
+    Op::builder_append();
+    REQUIRE(VM::has_error());
+    VM::set_error(Object::Undefined);
+#endif
+
+    VM::pop_frame();
+}
+
+TEST_CASE("String builder append builder", "[builder]") {
+    VM::push_frame();
+
+    std::string big(80, 'y');
+    Object builder = VM::StringBuilder();
+    builder.builder_append("a");
+    VM::String(big);
+    Op::builder_append();
+    builder.builder_append("b");
+    VM::push(builder);
+    Op::builder_append();
+    REQUIRE(builder.builder_size() == 2 * (big.size() + 2));
+
+    Op::builder_string();
+    assert_string(VM::peek(), "a" + big + "b" + "a" + big + "b");
+
+    VM::pop_frame();
+}
+
+TEST_CASE("String builder printing", "[builder]") {
+    VM::push_frame();
+
+    Object builder = VM::StringBuilder();
+    builder.builder_append("say \"");
+    VM::String(std::string(70, 'z') + "\n");
+    Op::builder_append();
+    builder.builder_append("\"");
+
+    std::string text = "say \"" + std::string(70, 'z') + "\n\"";
+    assert_tostring(builder, "\"say \\\"" + std::string(70, 'z') + "\\n\\\"\"");
+
+    std::ostringstream out;
+    {
+        Printer printer(out);
+        printer.display(builder);
+        printer.display(VM::Character(U'é'));
+    }
+    REQUIRE(out.str() == text + "é");
+
+    VM::pop_frame();
+}
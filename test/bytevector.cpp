@@ -0,0 +1,53 @@
+#include <sstream>
+
+#include "catch.h"
+#include "test.h"
+
+#include "object.h"
+#include "vm.h"
+
+
+TEST_CASE("Bytevector constructor", "[bytevector]") {
+    VM::push_frame();
+
+    Object obj = VM::Bytevector({1, 2, 255});
+    REQUIRE(obj.type() == Type::Bytevector);
+    REQUIRE(obj.nbytes() == 3);
+    REQUIRE(obj.bytes()[2] == 255);
+    assert_tostring(obj, "#u8(1 2 255)");
+
+    VM::push(VM::Fixnum(7));
+    VM::push(VM::Fixnum(8));
+    Op::bytevector(2);
+    assert_tostring(VM::peek(), "#u8(7 8)");
+
+    Op::make_bytevector(0, 0);
+    assert_tostring(VM::peek(), "#u8()");
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Bytevector bulk operations", "[bytevector]") {
+    VM::push_frame();
+
+    Op::make_bytevector(100, 3);
+    Object vec = VM::peek();
+    vec.fill_bytes(9, 10, 20);
+    REQUIRE(vec.bytes()[9] == 3);
+    REQUIRE(vec.bytes()[10] == 9);
+    REQUIRE(vec.bytes()[19] == 9);
+    REQUIRE(vec.bytes()[20] == 3);
+
+    Op::bytevector_copy(8, 12);
+    assert_tostring(VM::peek(), "#u8(3 3 9 9)");
+    REQUIRE(VM::peek().compare_bytes(vec) == 1);
+    REQUIRE(vec.compare_bytes(vec) == 0);
+
+    Object needle = VM::peek();
+    REQUIRE(vec.search_bytes(needle) == 8);
+    REQUIRE(vec.search_bytes(needle, 9) == std::string::npos);
+    vec.copy_bytes(90, needle, 0, 4);
+    REQUIRE(vec.search_bytes(needle, 9) == 90);
+
+    VM::pop_frame();
+}
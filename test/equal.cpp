@@ -0,0 +1,81 @@
+#include <sstream>
+
+#include "catch.h"
+#include "test.h"
+
+#include "gc.h"
+#include "hash.h"
+#include "object.h"
+#include "vm.h"
+
+
+TEST_CASE("Structural equality", "[equal]") {
+    VM::push_frame();
+
+    Object a = VM::List({VM::Intern("a"), VM::String("b"), VM::Vector({VM::Fixnum(1), VM::String("c")})});
+    Object b = VM::List({VM::Intern("a"), VM::String("b"), VM::Vector({VM::Fixnum(1), VM::String("c")})});
+    Object c = VM::List({VM::Intern("a"), VM::String("b"), VM::Vector({VM::Fixnum(1), VM::String("d")})});
+
+    REQUIRE(a != b);
+    REQUIRE(equal(a, b));
+    REQUIRE(hash_equal(a) == hash_equal(b));
+    REQUIRE(!equal(a, c));
+    REQUIRE(!equal(a, a.cdr()));
+    REQUIRE(equal(VM::Integer(INT64_MIN), VM::Integer(INT64_MIN)));
+    REQUIRE(!equal(VM::Fixnum(1), VM::Flonum(1.0)));
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Equality on deep and long structure", "[equal]") {
+    VM::push_frame();
+    GC::inhibit();
+
+    // Nested in the car and in the cdr direction
+    Object deep[2], flat[2];
+    for (int k = 0; k < 2; k++) {
+        deep[k] = Object::EmptyList;
+        flat[k] = Object::EmptyList;
+        for (int i = 0; i < 200000; i++) {
+            deep[k] = VM::Pair(deep[k], Object::EmptyList);
+            VM::pop();
+            flat[k] = VM::Pair(VM::Fixnum(i), flat[k]);
+            VM::pop();
+        }
+        VM::push(deep[k]);
+        VM::push(flat[k]);
+    }
+
+    GC::allow();
+    REQUIRE(equal(deep[0], deep[1]));
+    REQUIRE(equal(flat[0], flat[1]));
+    REQUIRE(hash_equal(flat[0]) == hash_equal(flat[1]));
+    REQUIRE(!equal(deep[0], flat[0]));
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Equality on cyclic structure", "[equal]") {
+    VM::push_frame();
+
+    // Cycles of length two and three over the same element unfold to the
+    // same infinite list
+    Object two = VM::List({VM::Fixnum(1), VM::Fixnum(1)});
+    two.cdr().set_cdr(two);
+    Object three = VM::List({VM::Fixnum(1), VM::Fixnum(1), VM::Fixnum(1)});
+    three.cddr().set_cdr(three);
+    REQUIRE(equal(two, three));
+    REQUIRE(hash_equal(two) == hash_equal(three));
+
+    Object other = VM::List({VM::Fixnum(1), VM::Fixnum(2)});
+    other.cdr().set_cdr(other);
+    REQUIRE(!equal(two, other));
+
+    Object vec = VM::Vector({VM::Fixnum(1), Object::EmptyList});
+    vec[1] = vec;
+    Object vec2 = VM::Vector({VM::Fixnum(1), Object::EmptyList});
+    vec2[1] = vec2;
+    REQUIRE(equal(vec, vec2));
+
+    VM::pop_frame();
+}
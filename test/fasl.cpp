@@ -0,0 +1,176 @@
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#include "catch.h"
+#include "test.h"
+
+#include "fasl.h"
+#include "hash.h"
+#include "object.h"
+#include "parse.h"
+#include "vm.h"
+
+
+static Object roundtrip(Object obj)
+{
+    std::ostringstream out;
+    REQUIRE(fasl_write(out, obj));
+    std::string data = out.str();
+    Op::fasl_read(data.data(), data.size());
+    return VM::peek();
+}
+
+TEST_CASE("Fasl round trip", "[fasl]") {
+    VM::push_frame();
+
+    std::istringstream code("(a \"str\" #(b #t ()) #u8(1 2) #f64(0.5) . tail)");
+    parse_all(code);
+    Object obj = VM::pop().car();
+    VM::push(obj);
+    VM::Integer(INT64_MIN);
+    VM::Flonum(-1.5);
+    VM::push(VM::Character(U'λ'));
+    Op::list(4);
+    obj = VM::peek();
+
+    Object copy = roundtrip(obj);
+    REQUIRE(copy != obj);
+    REQUIRE(equal(copy, obj));
+    REQUIRE(copy.car().car() == VM::Intern("a"));
+    assert_tostring(copy, "((a \"str\" #(b #t ()) #u8(1 2) #f64(0.5) . tail) -9223372036854775808 -1.5 #\\λ)");
+
+    Object table = VM::Table(Equivalence::Equal);
+    table.table_set(VM::String("key"), obj);
+    Object loaded = roundtrip(table);
+    REQUIRE(loaded.type() == Type::Table);
+    REQUIRE(equal(loaded.table_ref(VM::String("key")), obj));
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Fasl preserves sharing", "[fasl]") {
+    VM::push_frame();
+
+    Object shared = VM::List({VM::Fixnum(1), VM::String("x")});
+    Object obj = VM::List({shared, shared});
+    obj.cdr().set_cdr(obj);
+
+    Object copy = roundtrip(obj);
+    REQUIRE(copy.car() == copy.cadr());
+    REQUIRE(copy.cddr() == copy);
+    assert_tostring(copy, "#0=((1 \"x\") (1 \"x\") . #0#)");
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Fasl records", "[fasl]") {
+    VM::push_frame();
+
+    Object point = VM::RecordType("point", {"x", "y"});
+    VM::Integer(INT64_MAX);
+    VM::String("y");
+    Op::record(2);
+    Object p = VM::peek();
+    VM::push(point);
+    VM::push(VM::Fixnum(1));
+    VM::push(p);
+    Op::record(2);
+    Object q = VM::peek();
+    Object obj = VM::List({Object::EmptyList, p, q});
+
+    Object copy = roundtrip(obj);
+    assert_tostring(copy, "(() #<point> #<point>)");
+    Object p2 = copy.cadr(), q2 = copy.caddr();
+    REQUIRE(p2 != p);
+    REQUIRE(p2.record_type() == q2.record_type());
+    REQUIRE(p2.record_type() != point);
+    assert_symbol(p2.record_type().record_name(), "point");
+    REQUIRE(p2.record_type().field_index(VM::Intern("y")) == 1);
+    REQUIRE(equal(p2.slots()[0], VM::Integer(INT64_MAX)));
+    assert_string(p2.slots()[1], "y");
+    assert_fixnum(q2.slots()[0], 1);
+    REQUIRE(q2.slots()[1] == p2);
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Fasl string builders", "[fasl]") {
+    VM::push_frame();
+
+    Object builder = VM::StringBuilder();
+    Object shared = VM::String(std::string(100, 'x'));
+    builder.builder_append("head ");
+    builder.builder_append(shared);
+    builder.builder_append(" tail");
+
+    Object copy = roundtrip(builder);
+    REQUIRE(copy.type() == Type::StringBuilder);
+    REQUIRE(copy.builder_size() == builder.builder_size());
+    Op::builder_string();
+    assert_string(VM::peek(), "head " + std::string(100, 'x') + " tail");
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Fasl file loading", "[fasl]") {
+    VM::push_frame();
+
+    std::string path = "brim-test.fasl";
+    Object obj = VM::List({VM::Intern("file"), VM::String("contents")});
+    REQUIRE(fasl_write_file(path, obj));
+    Op::fasl_load(path);
+    std::remove(path.c_str());
+    REQUIRE(equal(VM::peek(), obj));
+
+    Op::fasl_load("does-not-exist.fasl");
+    REQUIRE(VM::has_error());
+    VM::set_error(Object::Undefined);
+
+    std::ostringstream out;
+    REQUIRE(fasl_write(out, obj));
+    std::string data = out.str();
+    for (std::size_t len = 0; len < data.size(); len++) {
+        Op::fasl_read(data.data(), len);
+        REQUIRE(VM::has_error());
+        VM::set_error(Object::Undefined);
+        VM::pop();
+    }
+
+    VM::pop_frame();
+}
+
+// Overwrite the word at pos in serialized data and load the result
+static void read_patched(std::string data, std::size_t pos, const void* word, std::size_t n)
+{
+    std::memcpy(&data[pos], word, n);
+    Op::fasl_read(data.data(), data.size());
+}
+
+TEST_CASE("Fasl rejects corrupt records", "[fasl]") {
+    VM::push_frame();
+
+    // A bignum that fits in a fixnum once its top limb is cleared;
+    // its record ends with the limbs, just before the root reference
+    std::ostringstream big;
+    REQUIRE(fasl_write(big, VM::Integer(INT64_MAX)));
+    uint32_t zero = 0;
+    read_patched(big.str(), big.str().size() - 12, &zero, sizeof(zero));
+    REQUIRE(VM::has_error());
+    VM::set_error(Object::Undefined);
+    VM::pop();
+
+    // A string table whose only key is replaced by a fixnum; the key
+    // and value precede the root reference
+    Object table = VM::Table(Equivalence::String);
+    table.table_set(VM::String("key"), VM::Fixnum(1));
+    std::ostringstream strings;
+    REQUIRE(fasl_write(strings, table));
+    uint64_t key = VM::Fixnum(7).view();
+    read_patched(strings.str(), strings.str().size() - 24, &key, sizeof(key));
+    REQUIRE(VM::has_error());
+    VM::set_error(Object::Undefined);
+    VM::pop();
+
+    VM::pop_frame();
+}
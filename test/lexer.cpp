@@ -3,21 +3,36 @@
 #include "catch.h"
 
 #include "parse.h"
+#include "simd.h"
 
 
-std::vector<Token> tokenize(std::string code)
+// Tokens are views into the lexer's input, so keep copies
+struct Lexeme {
+    std::string text;
+    std::size_t position;
+    TokenKind kind;
+
+    bool operator==(const std::string& rhs) const { return text == rhs; }
+};
+
+std::vector<Lexeme> tokenize(Lexer& lexer)
 {
-    std::istringstream stream(code);
-    Lexer lexer(stream);
-    std::vector<Token> ret;
+    std::vector<Lexeme> ret;
     while (lexer) {
         Token token;
         lexer >> token;
-        ret.push_back(token);
+        ret.push_back({token.string(), token.position(), token.kind()});
     }
     return ret;
 }
 
+std::vector<Lexeme> tokenize(std::string code)
+{
+    std::istringstream stream(code);
+    Lexer lexer(stream);
+    return tokenize(lexer);
+}
+
 TEST_CASE("Tokenize symbols", "[lexer]") {
     auto tokens = tokenize("a bcd ef");
 
@@ -34,6 +49,22 @@ TEST_CASE("Hash constructs", "[lexer]") {
     REQUIRE(tokens[0] == "#t");
     REQUIRE(tokens[1] == "#f");
     REQUIRE(tokens[2] == "#(");
+    REQUIRE(tokens[0].kind == TokenKind::Atom);
+    REQUIRE(tokens[2].kind == TokenKind::OpenVector);
+}
+
+TEST_CASE("Characters", "[lexer]") {
+    auto tokens = tokenize("#\\a #\\( #\\space(#\\ )");
+
+    REQUIRE(tokens.size() == 6);
+    REQUIRE(tokens[0] == "#\\a");
+    REQUIRE(tokens[1] == "#\\(");
+    REQUIRE(tokens[2] == "#\\space");
+    REQUIRE(tokens[3] == "(");
+    REQUIRE(tokens[4] == "#\\ ");
+    REQUIRE(tokens[5] == ")");
+    REQUIRE(tokens[0].kind == TokenKind::Character);
+    REQUIRE(tokens[4].kind == TokenKind::Character);
 }
 
 TEST_CASE("Strings", "[lexer]") {
@@ -41,6 +72,7 @@ TEST_CASE("Strings", "[lexer]") {
 
     REQUIRE(tokens.size() == 1);
     REQUIRE(tokens[0] == "\"here's a string\"");
+    REQUIRE(tokens[0].kind == TokenKind::String);
 }
 
 TEST_CASE("String with escape sequence", "[lexer]") {
@@ -78,6 +110,10 @@ TEST_CASE("Parens", "[lexer]") {
     REQUIRE(tokens[7] == ")");
     REQUIRE(tokens[8] == "#(");
     REQUIRE(tokens[9] == "]");
+    REQUIRE(tokens[0].kind == TokenKind::Open);
+    REQUIRE(tokens[2].kind == TokenKind::Close);
+    REQUIRE(tokens[3].kind == TokenKind::OpenBracket);
+    REQUIRE(tokens[4].kind == TokenKind::CloseBracket);
 }
 
 TEST_CASE("Quotations", "[lexer]") {
@@ -90,4 +126,142 @@ TEST_CASE("Quotations", "[lexer]") {
     REQUIRE(tokens[3] == "something");
     REQUIRE(tokens[4] == ",@");
     REQUIRE(tokens[5] == "list");
+    REQUIRE(tokens[0].kind == TokenKind::Quote);
+    REQUIRE(tokens[1].kind == TokenKind::Quasiquote);
+    REQUIRE(tokens[2].kind == TokenKind::Unquote);
+    REQUIRE(tokens[4].kind == TokenKind::UnquoteSplicing);
+}
+
+TEST_CASE("Dots", "[lexer]") {
+    auto tokens = tokenize("(a . b) ...");
+
+    REQUIRE(tokens.size() == 6);
+    REQUIRE(tokens[2].kind == TokenKind::Dot);
+    REQUIRE(tokens[5] == "...");
+    REQUIRE(tokens[5].kind == TokenKind::Symbol);
+}
+
+TEST_CASE("Symbols are recognized while lexing", "[lexer]") {
+    auto tokens = tokenize("abc set-car! <=? + - ... λx 1a -x a#b .. #foo");
+    std::vector<TokenKind> kinds;
+    for (auto& token : tokens)
+        kinds.push_back(token.kind);
+
+    REQUIRE(kinds == std::vector<TokenKind>{
+            TokenKind::Symbol, TokenKind::Symbol, TokenKind::Symbol, TokenKind::Symbol,
+            TokenKind::Symbol, TokenKind::Symbol, TokenKind::Symbol, TokenKind::Atom,
+            TokenKind::Atom, TokenKind::Atom, TokenKind::Atom, TokenKind::Atom});
+}
+
+TEST_CASE("Comments", "[lexer]") {
+    auto tokens = tokenize("a ; comment (\nb;c\n #| block #| nested |# ) |# c #|x|#d #|||#e");
+
+    REQUIRE(tokens.size() == 5);
+    REQUIRE(tokens[0] == "a");
+    REQUIRE(tokens[1] == "b");
+    REQUIRE(tokens[2] == "c");
+    REQUIRE(tokens[3] == "d");
+    REQUIRE(tokens[4] == "e");
+    REQUIRE(tokens[1].position == 14);
+}
+
+TEST_CASE("Datum comments", "[lexer]") {
+    auto tokens = tokenize("a #;b c #;(d (e) #(f)) g #;'h i #;#;j k l (m #;n) #;(o");
+
+    REQUIRE(tokens.size() == 8);
+    REQUIRE(tokens[0] == "a");
+    REQUIRE(tokens[1] == "c");
+    REQUIRE(tokens[2] == "g");
+    REQUIRE(tokens[3] == "i");
+    REQUIRE(tokens[4] == "l");
+    REQUIRE(tokens[5] == "(");
+    REQUIRE(tokens[6] == "m");
+    REQUIRE(tokens[7] == ")");
+}
+
+TEST_CASE("Comments across chunks", "[lexer]") {
+    // Comments longer than a chunk are skipped without being kept
+    std::string code = "a ; " + std::string(LEXER_CHUNK_SIZE, 'x') + "\nb #| "
+        + std::string(2 * LEXER_CHUNK_SIZE, '|') + " |# c";
+    code += std::string(4 * LEXER_CHUNK_SIZE - code.size() - 1, ' ') + "#| |# d";
+
+    auto tokens = tokenize(code);
+    REQUIRE(tokens.size() == 4);
+    REQUIRE(tokens[1] == "b");
+    REQUIRE(tokens[2] == "c");
+    REQUIRE(tokens[3] == "d");
+    REQUIRE(tokens[3].position == code.size() - 1);
+}
+
+TEST_CASE("Buffer and stream lexers agree", "[lexer]") {
+    // Put tokens across the boundary between the stream's chunks
+    std::string code(LEXER_CHUNK_SIZE - 150, ' ');
+    for (std::size_t i = 0; i < 16; i++)
+        code += std::string(i, ' ') + "ab\"c\\\"d\" ,@e #u8(";
+
+    auto streamed = tokenize(code);
+    Lexer lexer(code);
+    auto buffered = tokenize(lexer);
+
+    REQUIRE(streamed.size() == 16 * 5);
+    REQUIRE(buffered.size() == streamed.size());
+    for (std::size_t i = 0; i < streamed.size(); i++) {
+        REQUIRE(buffered[i] == streamed[i].text);
+        REQUIRE(buffered[i].position == streamed[i].position);
+        REQUIRE(buffered[i].kind == streamed[i].kind);
+    }
+    REQUIRE(streamed[1] == "\"c\\\"d\"");
+    REQUIRE(streamed[2] == ",@");
+    REQUIRE(streamed[4] == "#u8(");
+    REQUIRE(streamed[4].kind == TokenKind::OpenNumVector);
+    REQUIRE(code.substr(streamed[5].position, 2) == "ab");
+}
+
+TEST_CASE("Tokens outlive the next token", "[lexer]") {
+    // Chunk refills and spills must not clobber the token handed out last
+    std::string code(LEXER_CHUNK_SIZE - 150, ' ');
+    for (std::size_t i = 0; i < 64; i++)
+        code += std::string(i, ' ') + "\"s" + std::to_string(i) + "\" sym" + std::to_string(i) + " ";
+
+    std::istringstream stream(code);
+    Lexer lexer(stream);
+    Token previous;
+    lexer >> previous;
+    while (lexer) {
+        std::string expected = previous.string();
+        Token token;
+        lexer >> token;
+        REQUIRE(previous == expected);
+        REQUIRE(code.substr(previous.position(), previous.size()) == expected);
+        previous = token;
+    }
+}
+
+TEST_CASE("Delimiter scanners", "[lexer]") {
+    // Each special byte at every offset of runs longer than a vector
+    std::string text(100, 'x');
+    for (char c : std::string("()[]\",`';\\ \t\n\v\f\r|#")) {
+        for (std::size_t i = 0; i < text.size(); i++) {
+            std::string s = text;
+            s[i] = c;
+            const char* begin = s.data();
+            const char* end = begin + s.size();
+            bool isquote = c == '"' || c == '\\';
+            bool isdelim = c != '\\' && c != '|' && c != '#';
+            bool isblock = c == '|' || c == '#';
+            REQUIRE(simd_find_delimiter(begin, end) == (isdelim ? begin + i : end));
+            REQUIRE(simd_find_quote(begin, end) == (isquote ? begin + i : end));
+            REQUIRE(simd_find_block(begin, end) == (isblock ? begin + i : end));
+            REQUIRE(simd_find_newline(begin, end) == (c == '\n' ? begin + i : end));
+        }
+    }
+
+    std::string spaces(100, ' ');
+    for (std::size_t i = 0; i < spaces.size(); i++) {
+        std::string s = spaces;
+        s[i] = '\x80';
+        REQUIRE(simd_skip_space(s.data(), s.data() + s.size()) == s.data() + i);
+        REQUIRE(simd_find_delimiter(s.data() + i, s.data() + s.size()) == s.data() + i + 1);
+    }
+    REQUIRE(simd_skip_space(spaces.data(), spaces.data() + 100) == spaces.data() + 100);
 }
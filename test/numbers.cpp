@@ -0,0 +1,97 @@
+#include <sstream>
+
+#include "catch.h"
+#include "test.h"
+
+#include "object.h"
+#include "vm.h"
+
+
+static std::string power(int64_t base, int exponent)
+{
+    VM::Integer(1);
+    for (int i = 0; i < exponent; i++) {
+        VM::Integer(base);
+        Op::mul();
+    }
+    std::ostringstream str;
+    str << VM::pop();
+    return str.str();
+}
+
+TEST_CASE("Fixnum arithmetic", "[numbers]") {
+    VM::push_frame();
+
+    VM::Integer(40);
+    VM::Integer(2);
+    Op::add();
+    assert_fixnum(VM::peek(), 42);
+
+    VM::Integer(50);
+    Op::sub();
+    assert_fixnum(VM::peek(), -8);
+
+    VM::Integer(-7);
+    Op::mul();
+    assert_fixnum(VM::peek(), 56);
+
+    Op::neg();
+    assert_fixnum(VM::peek(), -56);
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Overflow promotes to bignum", "[numbers]") {
+    VM::push_frame();
+
+    VM::Integer(Object::FixnumMax);
+    VM::Integer(1);
+    Op::add();
+    REQUIRE(VM::peek().type() == Type::Bignum);
+    assert_tostring(VM::peek(), "4611686018427387904");
+
+    VM::Integer(1);
+    Op::sub();
+    assert_fixnum(VM::peek(), Object::FixnumMax);
+
+    VM::Integer(Object::FixnumMin);
+    Op::neg();
+    REQUIRE(VM::peek().type() == Type::Bignum);
+    assert_tostring(VM::peek(), "4611686018427387904");
+
+    VM::Integer(INT64_MIN);
+    assert_tostring(VM::peek(), "-9223372036854775808");
+    VM::Unsigned(UINT64_MAX);
+    assert_tostring(VM::peek(), "18446744073709551615");
+    Op::add();
+    assert_tostring(VM::peek(), "9223372036854775807");
+
+    VM::Integer(3037000500);
+    VM::Integer(3037000500);
+    Op::mul();
+    assert_tostring(VM::peek(), "9223372037000250000");
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Large multiplication", "[numbers]") {
+    VM::push_frame();
+
+    REQUIRE(power(10, 40) == "1" + std::string(40, '0'));
+    REQUIRE(power(-3, 3) == "-27");
+
+    // Exercise the Karatsuba path and check it against repeated
+    // schoolbook multiplication
+    std::ostringstream str;
+    VM::Integer(7);
+    for (int i = 0; i < 10; i++) {
+        VM::push(VM::peek());
+        Op::mul();
+    }
+    VM::push(VM::peek());
+    Op::mul();
+    str << VM::pop();
+    REQUIRE(str.str() == power(7, 2048));
+
+    VM::pop_frame();
+}
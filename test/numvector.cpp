@@ -0,0 +1,106 @@
+#include <sstream>
+
+#include "catch.h"
+#include "test.h"
+
+#include "object.h"
+#include "vm.h"
+
+
+TEST_CASE("Numeric vector access", "[numvector]") {
+    VM::push_frame();
+
+    int32_t data[] = {1, -2, 3};
+    VM::NumVector(Numeric::S32, data, 3);
+    assert_tostring(VM::peek(), "#s32(1 -2 3)");
+
+    VM::push(VM::Fixnum(-7));
+    Op::numvector_set(2);
+    VM::push(VM::peek());
+    Op::numvector_ref(2);
+    assert_fixnum(VM::peek(), -7);
+    VM::pop();
+
+#ifndef BRIM_ASSERT_CHECKS
+    VM::Integer(INT64_MAX);
+    Op::numvector_set(0);
+    REQUIRE(VM::has_error());
+    VM::set_error(Object::Undefined);
+#endif
+
+    VM::NumVector(Numeric::U64, nullptr, 1);
+    VM::Unsigned(UINT64_MAX);
+    Op::numvector_set(0);
+    Op::numvector_ref(0);
+    assert_tostring(VM::peek(), "18446744073709551615");
+    VM::pop();
+
+    VM::NumVector(Numeric::F64, nullptr, 2);
+    VM::Flonum(0.5);
+    Op::numvector_set(1);
+    Op::numvector_ref(1);
+    REQUIRE(VM::peek().type() == Type::Flonum);
+    REQUIRE(VM::peek().flonum() == 0.5);
+    VM::pop();
+
+    // u8 vectors are bytevectors
+    uint8_t bytes[] = {1, 2, 255};
+    VM::NumVector(Numeric::U8, bytes, 3);
+    REQUIRE(VM::peek().type() == Type::Bytevector);
+    VM::push(VM::Fixnum(7));
+    Op::numvector_set(0);
+    VM::push(VM::peek());
+    Op::numvector_ref(0);
+    assert_fixnum(VM::peek(), 7);
+    VM::pop();
+    VM::push(VM::Fixnum(256));
+    Op::numvector_set(1);
+    REQUIRE(VM::has_error());
+    VM::set_error(Object::Undefined);
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Numeric vector kernels", "[numvector]") {
+    VM::push_frame();
+
+    int8_t a[] = {100, -5, 3};
+    int8_t b[] = {100, 10, -4};
+    VM::NumVector(Numeric::S8, a, 3);
+    VM::NumVector(Numeric::S8, b, 3);
+    Op::numvector_add();
+    assert_tostring(VM::peek(), "#s8(-56 5 -1)");
+
+    VM::NumVector(Numeric::S8, b, 3);
+    Op::numvector_mul();
+    assert_tostring(VM::peek(), "#s8(32 50 4)");
+
+    uint8_t c[] = {200, 1, 0};
+    VM::NumVector(Numeric::U8, c, 3);
+    VM::NumVector(Numeric::U8, c, 3);
+    Op::numvector_add();
+    REQUIRE(VM::peek().type() == Type::Bytevector);
+    REQUIRE(VM::peek().bytes()[0] == 144);
+    REQUIRE(VM::peek().bytes()[1] == 2);
+    VM::pop();
+
+    std::vector<double> x(1000), y(1000);
+    for (std::size_t i = 0; i < x.size(); i++) {
+        x[i] = i;
+        y[i] = 0.5 * i;
+    }
+    VM::NumVector(Numeric::F64, x.data(), x.size());
+    VM::NumVector(Numeric::F64, y.data(), y.size());
+    Op::numvector_sub();
+    REQUIRE(VM::peek().length() == 1000);
+    REQUIRE(VM::peek().elements<double>()[999] == 499.5);
+
+#ifndef BRIM_ASSERT_CHECKS
+    VM::NumVector(Numeric::F32, nullptr, 1000);
+    Op::numvector_add();
+    REQUIRE(VM::has_error());
+    VM::set_error(Object::Undefined);
+#endif
+
+    VM::pop_frame();
+}
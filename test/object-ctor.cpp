@@ -1,6 +1,7 @@
 #include "catch.h"
 #include "test.h"
 
+#include "gc.h"
 #include "object.h"
 #include "vm.h"
 
@@ -18,6 +19,12 @@ TEST_CASE("Fixnum constructor", "[object-ctor]") {
 TEST_CASE("Character constructor", "[object-ctor]") {
     Object obj = VM::Character('u');
     assert_character(obj, 'u');
+
+    obj = VM::Character(U'\u03bb');
+    assert_character(obj, U'\u03bb');
+
+    obj = VM::Character(U'\U0001f600');
+    assert_character(obj, U'\U0001f600');
 }
 
 TEST_CASE("Symbol constructor", "[object-ctor]") {
@@ -33,6 +40,138 @@ TEST_CASE("String constructor", "[object-ctor]") {
 
     Object obj = VM::String("alpha");
     assert_string(obj, "alpha");
+    REQUIRE(obj.ascii());
+    REQUIRE(obj.string_length() == 5);
+    REQUIRE(obj.string_ref(3) == 'h');
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Unicode string constructor", "[object-ctor]") {
+    VM::push_frame();
+
+    std::string data;
+    for (int i = 0; i < 100; i++)
+        data += "a\u00e6\u03bb\U0001f600";
+    Object obj = VM::String(data);
+    assert_string(obj, data);
+    REQUIRE(!obj.ascii());
+    REQUIRE(obj.string_length() == 400);
+    for (std::size_t i = 0; i < 400; i += 4) {
+        REQUIRE(obj.string_ref(i) == 'a');
+        REQUIRE(obj.string_ref(i + 1) == U'\u00e6');
+        REQUIRE(obj.string_ref(i + 2) == U'\u03bb');
+        REQUIRE(obj.string_ref(i + 3) == U'\U0001f600');
+    }
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Immediate strings", "[object-ctor]") {
+    VM::push_frame();
+
+    std::size_t objects = GC::size();
+    Object obj = VM::String("gamma");
+    assert_string(obj, "gamma");
+    REQUIRE(obj.immediate());
+    REQUIRE(obj.immutable());
+    REQUIRE(obj.ascii());
+    REQUIRE(obj.string_length() == 5);
+    REQUIRE(obj.string_ref(4) == 'a');
+    REQUIRE(obj == VM::String("gamma"));
+
+    Object uni = VM::String("\u00e6\U0001f600");
+    REQUIRE(uni.immediate());
+    REQUIRE(!uni.ascii());
+    REQUIRE(uni.string_length() == 2);
+    REQUIRE(uni.string_ref(1) == U'\U0001f600');
+
+    Object empty = VM::String("");
+    REQUIRE(empty == Object::EmptyString);
+    assert_string(empty, "");
+    REQUIRE(empty.string_length() == 0);
+
+    REQUIRE(!VM::String("eight ch").immediate());
+    REQUIRE(GC::size() == objects + 1);
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Empty vector", "[object-ctor]") {
+    VM::push_frame();
+
+    Object obj = VM::Vector({});
+    REQUIRE(obj == Object::EmptyVector);
+    assert_vector(obj, 0);
+    REQUIRE(obj.immediate());
+    REQUIRE(obj.begin() == obj.end());
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Substrings", "[object-ctor]") {
+    VM::push_frame();
+
+    std::string data;
+    for (int i = 0; i < 100; i++)
+        data += "a\u00e6\u03bb\U0001f600";
+    Object str = VM::String(data);
+
+    // Short substrings are copied
+    VM::push(str);
+    Op::substring(1, 3);
+    assert_string(VM::peek(), "\u00e6\u03bb");
+    REQUIRE(VM::peek().string_parent().undefined());
+    VM::pop();
+
+    // Long ones share the parent's bytes, also through other views
+    VM::push(str);
+    Op::substring(4, 396);
+    Object view = VM::peek();
+    REQUIRE(view.string_parent() == str);
+    REQUIRE(view.text().data() == str.text().data() + 9);
+    REQUIRE(view.string_length() == 392);
+    REQUIRE(view.string_ref(391) == U'\U0001f600');
+    Op::substring(8, 16);
+    REQUIRE(VM::peek().string_parent() == str);
+    REQUIRE(VM::peek().string_ref(0) == 'a');
+    REQUIRE(VM::peek().string_length() == 8);
+    VM::pop();
+
+#ifndef BRIM_ASSERT_CHECKS
+    VM::push(str);
+    Op::substring(3, 401);
+    REQUIRE(VM::has_error());
+    VM::set_error(Object::Undefined);
+#endif
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Substrings and collection", "[object-ctor]") {
+    VM::push_frame();
+
+    std::string data(1000, 'x');
+    data.replace(100, 5, "hello");
+
+    // A view covering most of an unreachable parent keeps it alive
+    VM::String(data);
+    Op::substring(0, 900);
+    Object big = VM::peek();
+    Object parent = big.string_parent();
+    GC::collect();
+    REQUIRE(big.string_parent() == parent);
+    assert_string(big, data.substr(0, 900));
+    VM::pop();
+
+    // A small view gets its own copy instead
+    VM::String(data);
+    Op::substring(90, 120);
+    Object small = VM::peek();
+    REQUIRE(small.string_parent().defined());
+    GC::collect();
+    REQUIRE(small.string_parent().undefined());
+    assert_string(small, data.substr(90, 30));
 
     VM::pop_frame();
 }
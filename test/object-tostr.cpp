@@ -3,7 +3,9 @@
 #include "catch.h"
 #include "test.h"
 
+#include "gc.h"
 #include "object.h"
+#include "print.h"
 #include "vm.h"
 
 
@@ -15,6 +17,12 @@ TEST_CASE("Fixnum to-string", "[object-tostr]") {
 
 TEST_CASE("Character to-string", "[object-tostr]") {
     assert_tostring(VM::Character('u'), "#\\u");
+    assert_tostring(VM::Character(U'\u03bb'), "#\\\u03bb");
+    assert_tostring(VM::Character(' '), "#\\space");
+    assert_tostring(VM::Character('\n'), "#\\newline");
+    assert_tostring(VM::Character(0), "#\\null");
+    assert_tostring(VM::Character(0x7f), "#\\delete");
+    assert_tostring(VM::Character(0x1), "#\\x1");
 }
 
 TEST_CASE("Symbol to-string", "[object-tostr]") {
@@ -24,6 +32,8 @@ TEST_CASE("Symbol to-string", "[object-tostr]") {
 TEST_CASE("String to-string", "[object-tostr]") {
     VM::push_frame();
     assert_tostring(VM::String("beta"), "\"beta\"");
+    assert_tostring(VM::String("a long string with \"quotes\" and \\ and\ttabs\n"),
+                    "\"a long string with \\\"quotes\\\" and \\\\ and\\ttabs\\n\"");
     VM::pop_frame();
 }
 
@@ -32,6 +42,8 @@ TEST_CASE("Special to-string", "[object-tostr]") {
     assert_tostring(Object::True, "#t");
     assert_tostring(Object::EmptyList, "()");
     assert_tostring(Object::Undefined, "#<undefined>");
+    assert_tostring(Object::EmptyString, "\"\"");
+    assert_tostring(Object::EmptyVector, "#()");
 }
 
 TEST_CASE("List to-string", "[object-tostr]") {
@@ -62,3 +74,50 @@ TEST_CASE("Vector to-string", "[object-tostr]") {
     assert_tostring(obj, "#(a b c d)");
     VM::pop_frame();
 }
+
+TEST_CASE("Cyclic to-string", "[object-tostr]") {
+    VM::push_frame();
+
+    Object obj = VM::List({VM::Intern("a"), VM::Intern("b")});
+    obj.cdr().set_cdr(obj);
+    assert_tostring(obj, "#0=(a b . #0#)");
+
+    Object vec = VM::Vector({VM::Intern("a"), Object::EmptyList});
+    vec[1] = VM::List({vec});
+    assert_tostring(vec, "#0=#(a (#0#))");
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Shared to-string", "[object-tostr]") {
+    VM::push_frame();
+
+    Object shared = VM::List({VM::Fixnum(1)});
+    Object obj = VM::List({shared, shared});
+    assert_tostring(obj, "((1) (1))");
+
+    Printer printer(Labels::Shared);
+    printer.print(obj);
+    REQUIRE(printer.str() == "(#0=(1) #0#)");
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Deep to-string", "[object-tostr]") {
+    VM::push_frame();
+    GC::inhibit();
+
+    Object obj = Object::EmptyList;
+    for (int i = 0; i < 100000; i++) {
+        obj = VM::Pair(obj, Object::EmptyList);
+        VM::pop();
+    }
+    VM::push(obj);
+    GC::allow();
+
+    std::ostringstream str;
+    str << obj;
+    REQUIRE(str.str() == std::string(100001, '(') + std::string(100001, ')'));
+
+    VM::pop_frame();
+}
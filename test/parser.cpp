@@ -1,20 +1,35 @@
+#include <cstdio>
+#include <fstream>
 #include <sstream>
 
 #include "catch.h"
 #include "test.h"
 
+#include "gc.h"
 #include "object.h"
 #include "parse.h"
 #include "vm.h"
 
 
-Object parse(std::string code)
+Object parse(std::string code, bool hashcons = false)
 {
     VM::push_frame();
     std::istringstream stream(code);
-    parse_all(stream);
+    parse_all(stream, hashcons);
 
     Object retval = VM::has_error() ? VM::get_error() : VM::peek();
+    VM::set_error(Object::Undefined);
+    VM::pop_frame();
+    return retval;
+}
+
+Object parse_in_parallel(std::string_view code, unsigned nthreads, bool hashcons = false)
+{
+    VM::push_frame();
+    parse_parallel(code, hashcons, nthreads);
+
+    Object retval = VM::has_error() ? VM::get_error() : VM::peek();
+    VM::set_error(Object::Undefined);
     VM::pop_frame();
     return retval;
 }
@@ -42,6 +57,105 @@ TEST_CASE("Parse strings", "[parser]") {
     assert_string(objects.nth(0), "a string \n \t \\ \"");
 }
 
+TEST_CASE("Parse unicode", "[parser]") {
+    auto objects = parse("\"gr\u00fc\u00dfe \u4e16\u754c\" \u03bb\u03b1");
+
+    REQUIRE(objects.proper_list(2));
+    assert_string(objects.nth(0), "gr\u00fc\u00dfe \u4e16\u754c");
+    REQUIRE(objects.nth(0).string_length() == 8);
+    REQUIRE(objects.nth(0).string_ref(7) == U'\u754c');
+    assert_symbol(objects.nth(1), "\u03bb\u03b1");
+}
+
+TEST_CASE("Parse integers", "[parser]") {
+    auto objects = parse("42 -7 +3 0 #xff #X-1A #o17 #b-101 #d10 4611686018427387904 -9223372036854775809");
+
+    REQUIRE(objects.proper_list(11));
+    assert_fixnum(objects.nth(0), 42);
+    assert_fixnum(objects.nth(1), -7);
+    assert_fixnum(objects.nth(2), 3);
+    assert_fixnum(objects.nth(3), 0);
+    assert_fixnum(objects.nth(4), 255);
+    assert_fixnum(objects.nth(5), -26);
+    assert_fixnum(objects.nth(6), 15);
+    assert_fixnum(objects.nth(7), -5);
+    assert_fixnum(objects.nth(8), 10);
+    REQUIRE(objects.nth(9).type() == Type::Bignum);
+    assert_tostring(objects.nth(9), "4611686018427387904");
+    assert_tostring(objects.nth(10), "-9223372036854775809");
+}
+
+TEST_CASE("Parse bignums", "[parser]") {
+    auto objects = parse("123456789012345678901234567890 -340282366920938463463374607431768211456 "
+                         "#xffffffffffffffffffffffff #b10000000000000000000000000000000000000000000000000000000000000000");
+
+    REQUIRE(objects.proper_list(4));
+    assert_tostring(objects.nth(0), "123456789012345678901234567890");
+    assert_tostring(objects.nth(1), "-340282366920938463463374607431768211456");
+    assert_tostring(objects.nth(2), "79228162514264337593543950335");
+    assert_tostring(objects.nth(3), "18446744073709551616");
+}
+
+TEST_CASE("Parse flonums", "[parser]") {
+    auto objects = parse("1.5 -0.25 .5 1e3 -2.5e-3 +inf.0 -inf.0 1e400");
+
+    REQUIRE(objects.proper_list(8));
+    REQUIRE(objects.nth(0).type() == Type::Flonum);
+    REQUIRE(objects.nth(0).flonum() == 1.5);
+    REQUIRE(objects.nth(1).flonum() == -0.25);
+    REQUIRE(objects.nth(2).flonum() == 0.5);
+    REQUIRE(objects.nth(3).flonum() == 1000.0);
+    REQUIRE(objects.nth(4).flonum() == -2.5e-3);
+    assert_tostring(objects.nth(5), "+inf.0");
+    assert_tostring(objects.nth(6), "-inf.0");
+    assert_tostring(objects.nth(7), "+inf.0");
+}
+
+TEST_CASE("Parse malformed numbers", "[parser]") {
+    REQUIRE(parse("1a").type() == Type::Error);
+    REQUIRE(parse("#xfg").type() == Type::Error);
+    REQUIRE(parse("#b2").type() == Type::Error);
+    REQUIRE(parse("#x1.5").type() == Type::Error);
+    REQUIRE(parse("--1").type() == Type::Error);
+    REQUIRE(parse("+inf").type() == Type::Error);
+    REQUIRE(parse("1e").type() == Type::Error);
+    REQUIRE(parse("#x").type() == Type::Error);
+}
+
+TEST_CASE("Parse characters", "[parser]") {
+    auto objects = parse("#\\a #\\\u03bb #\\( #\\) #\\space #\\newline #\\alarm #\\x #\\x41 #\\x1F600 (#\\tab)");
+
+    REQUIRE(objects.proper_list(11));
+    assert_character(objects.nth(0), 'a');
+    assert_character(objects.nth(1), U'\u03bb');
+    assert_character(objects.nth(2), '(');
+    assert_character(objects.nth(3), ')');
+    assert_character(objects.nth(4), ' ');
+    assert_character(objects.nth(5), '\n');
+    assert_character(objects.nth(6), 0x07);
+    assert_character(objects.nth(7), 'x');
+    assert_character(objects.nth(8), 'A');
+    assert_character(objects.nth(9), U'\U0001f600');
+    assert_character(objects.nth(10).nth(0), '\t');
+
+    REQUIRE(parse("#\\nope").type() == Type::Error);
+    REQUIRE(parse("#\\xzz").type() == Type::Error);
+    REQUIRE(parse("#\\x110000").type() == Type::Error);
+    REQUIRE(parse("#\\").type() == Type::Error);
+}
+
+TEST_CASE("Parse printed characters", "[parser]") {
+    std::ostringstream printed;
+    for (char32_t c : { 0, 1, 7, 8, 9, 10, 13, 27, 32, 0x41, 0x7f, 0x3bb })
+        printed << VM::Character(c) << " ";
+    auto objects = parse(printed.str());
+
+    REQUIRE(objects.proper_list(12));
+    for (std::size_t i = 0; i < 12; i++)
+        REQUIRE(objects.nth(i).type() == Type::Character);
+    assert_tostring(objects, "(" + printed.str().substr(0, printed.str().size() - 1) + ")");
+}
+
 TEST_CASE("Parse empty list", "[parser]") {
     auto objects = parse("()");
 
@@ -89,3 +203,235 @@ TEST_CASE("Parse vector", "[parser]") {
     assert_symbol(objects.nth(0)[1], "b");
     assert_symbol(objects.nth(0)[2], "c");
 }
+
+TEST_CASE("Parse vector in list", "[parser]") {
+    auto objects = parse("(a #(b c) d)");
+
+    REQUIRE(objects.proper_list(1));
+    REQUIRE(objects.nth(0).proper_list(3));
+    assert_vector(objects.nth(0).nth(1), 2);
+    assert_symbol(objects.nth(0).nth(2), "d");
+}
+
+TEST_CASE("Parse numeric vectors", "[parser]") {
+    auto objects = parse("#u8(1 2 255) #s16(-32768 7) #u64(18446744073709551615) #f64(1 -2.5 1e300 +inf.0) #f32()");
+
+    REQUIRE(objects.proper_list(5));
+    REQUIRE(objects.nth(0).type() == Type::Bytevector);
+    assert_tostring(objects.nth(0), "#u8(1 2 255)");
+    REQUIRE(objects.nth(1).type() == Type::NumVector);
+    REQUIRE(objects.nth(1).numeric() == Numeric::S16);
+    assert_tostring(objects.nth(1), "#s16(-32768 7)");
+    assert_tostring(objects.nth(2), "#u64(18446744073709551615)");
+    REQUIRE(objects.nth(3).elements<double>()[1] == -2.5);
+    assert_tostring(objects.nth(3), "#f64(1.0 -2.5 1e+300 +inf.0)");
+    assert_tostring(objects.nth(4), "#f32()");
+}
+
+TEST_CASE("Parse numeric vectors out of range", "[parser]") {
+    REQUIRE(parse("#u8(256)").type() == Type::Error);
+    REQUIRE(parse("#s8(-129)").type() == Type::Error);
+    REQUIRE(parse("#u16(-1)").type() == Type::Error);
+    REQUIRE(parse("#f64(a)").type() == Type::Error);
+}
+
+TEST_CASE("Parse quotation", "[parser]") {
+    auto objects = parse("'a `(b ,c ,@d)");
+
+    REQUIRE(objects.proper_list(2));
+    REQUIRE(objects.nth(0).proper_list(2));
+    assert_symbol(objects.nth(0).nth(0), "quote");
+    assert_symbol(objects.nth(0).nth(1), "a");
+    assert_symbol(objects.nth(1).nth(0), "quasiquote");
+    assert_symbol(objects.nth(1).nth(1).nth(1).nth(0), "unquote");
+    assert_symbol(objects.nth(1).nth(1).nth(2).nth(0), "unquote-splicing");
+}
+
+TEST_CASE("Parse comments", "[parser]") {
+    auto objects = parse("; header\n(a #| b |# c ; d\n #;(e f) . g) #;h #;#;i j \"k;\" #\\; #;l");
+
+    REQUIRE(objects.proper_list(3));
+    assert_tostring(objects.nth(0), "(a c . g)");
+    assert_string(objects.nth(1), "k;");
+    assert_character(objects.nth(2), ';');
+}
+
+TEST_CASE("Parse errors", "[parser]") {
+    REQUIRE(parse("(a b").type() == Type::Error);
+    REQUIRE(parse("(a . b c)").type() == Type::Error);
+    REQUIRE(parse("(a . )").type() == Type::Error);
+    REQUIRE(parse("(a . b . c)").type() == Type::Error);
+    REQUIRE(parse("#(a . b)").type() == Type::Error);
+    REQUIRE(parse("'").type() == Type::Error);
+    REQUIRE(parse("(a ')").type() == Type::Error);
+    REQUIRE(parse(")").type() == Type::Error);
+    assert_tostring(parse("(a (b . c) #((d)) 'e)"), "((a (b . c) #((d)) (quote e)))");
+}
+
+TEST_CASE("Parse deeply nested data", "[parser]") {
+    const std::size_t depth = 100000;
+    std::string code;
+    for (std::size_t i = 0; i < depth; i++)
+        code += i % 3 == 0 ? "(" : i % 3 == 1 ? "#(" : "'";
+    code += "x";
+    for (std::size_t i = depth; i > 0; i--)
+        code += (i - 1) % 3 == 2 ? "" : ")";
+
+    VM::push_frame();
+    VM::push(parse(code));
+    GC::collect();
+
+    Object obj = VM::peek();
+    REQUIRE(obj.proper_list(1));
+    obj = obj.nth(0);
+    for (std::size_t i = 0; i < depth; i++) {
+        if (i % 3 == 0) {
+            REQUIRE(obj.proper_list(1));
+            obj = obj.nth(0);
+        }
+        else if (i % 3 == 1) {
+            assert_vector(obj, 1);
+            obj = obj[0];
+        }
+        else {
+            assert_symbol(obj.nth(0), "quote");
+            obj = obj.nth(1);
+        }
+    }
+    assert_symbol(obj, "x");
+    VM::pop_frame();
+}
+
+TEST_CASE("Parse with hash-consing", "[parser]") {
+    auto objects = parse("(a (b c)) (a (b c)) (b c) \"s\" \"s\" #(d (b c)) #(d (b c)) 'x 'x", true);
+
+    REQUIRE(objects.proper_list(9));
+    REQUIRE(objects.nth(0) == objects.nth(1));
+    REQUIRE(objects.nth(0).nth(1) == objects.nth(2));
+    REQUIRE(objects.nth(3) == objects.nth(4));
+    REQUIRE(objects.nth(5) == objects.nth(6));
+    const Object vec = objects.nth(5);
+    REQUIRE(vec[1] == objects.nth(2));
+    REQUIRE(objects.nth(7) == objects.nth(8));
+
+    REQUIRE(objects.nth(0).immutable());
+    REQUIRE(objects.nth(3).immutable());
+    REQUIRE(objects.nth(5).immutable());
+    REQUIRE(!objects.immutable());
+
+    auto plain = parse("(a b) (a b)");
+    REQUIRE(plain.nth(0) != plain.nth(1));
+    REQUIRE(!plain.nth(0).immutable());
+}
+
+TEST_CASE("Streaming reader", "[parser]") {
+    std::string code;
+    for (std::size_t i = 0; i < 20000; i++)
+        code += "(record " + std::to_string(i) + " \"payload string\" #(x y)) ; log line\n";
+    std::istringstream stream(code);
+    Reader reader(stream);
+
+    // Each record can be dropped once processed, leaving nothing behind
+    VM::push_frame();
+    GC::collect();
+    std::size_t count = 0, baseline = GC::size();
+    while (reader) {
+        Object obj = reader.read();
+        REQUIRE(!VM::has_error());
+        REQUIRE(obj.proper_list(4));
+        assert_fixnum(obj.nth(1), (int64_t)count);
+        VM::pop();
+        count++;
+    }
+    REQUIRE(count == 20000);
+    GC::collect();
+    REQUIRE(GC::size() <= baseline + 10);
+    REQUIRE(reader.read().undefined());
+    VM::pop_frame();
+
+    // A malformed datum leaves only Undefined on the stack, in place of
+    // the elements read so far
+    Reader bad("(a) (b c");
+    VM::push_frame();
+    Object first = bad.read();
+    assert_symbol(first.nth(0), "a");
+    Object second = bad.read();
+    REQUIRE(VM::has_error());
+    REQUIRE(second.undefined());
+    REQUIRE(VM::stack_size() == 2);
+    REQUIRE(VM::peek(1) == first);
+    VM::set_error(Object::Undefined);
+    REQUIRE(!bad);
+    REQUIRE(bad.read().undefined());
+    REQUIRE(!VM::has_error());
+    VM::pop_frame();
+}
+
+TEST_CASE("Parallel parsing", "[parser]") {
+    // Brackets inside strings, characters and comments must not be taken
+    // for places to cut the input
+    std::string code;
+    for (std::size_t i = 0; code.size() < 4 * PARSE_CHUNK_MIN; i++) {
+        code += "(rec " + std::to_string(i) + " \"str ) ( \\\" ;\" #\\( #\\) #\\; #\\\" 'q\n"
+            " #(v ,a) (a . b) #u8(1 2) 1.5 #| ) ( #| ) |# |# ; comment ) (\n"
+            " #;(skip me) #; #; x y)";
+        if (i % 1000 == 999)
+            code += " #;(dropped) #; #; (a) (b) 123456789012345678901234567890\n";
+        code += i % 7 == 0 ? "\n" : " ";
+    }
+
+    std::ostringstream sequential, parallel, shared;
+    sequential << parse(code);
+    parallel << parse_in_parallel(code, 4);
+    REQUIRE(parallel.str() == sequential.str());
+
+    // The data built by the worker threads joins the collected heap, with
+    // the same symbols as everything else
+    VM::push_frame();
+    GC::collect();
+    std::size_t baseline = GC::size();
+    parse_parallel(code, false, 3);
+    Object data = VM::peek();
+    REQUIRE(data.nth(0).nth(0) == VM::Intern("rec"));
+    GC::collect();
+    std::ostringstream collected;
+    collected << data;
+    REQUIRE(collected.str() == sequential.str());
+    VM::pop();
+    GC::collect();
+    REQUIRE(GC::size() <= baseline + 10);
+    VM::pop_frame();
+
+    Object pooled = parse_in_parallel(code, 3, true);
+    shared << pooled;
+    REQUIRE(shared.str() == sequential.str());
+    REQUIRE(pooled.nth(0).nth(8) == pooled.nth(5000).nth(8));
+
+    // Errors are reported at their position in the whole input
+    std::ostringstream error, expected;
+    error << parse_in_parallel(code + " (a . b c)", 4);
+    expected << "At " << code.size() + 8 << ": unmatched paranthesis";
+    REQUIRE(error.str().find(expected.str()) != std::string::npos);
+}
+
+TEST_CASE("Parse file", "[parser]") {
+    std::string path = "parse-file-test.scm";
+    {
+        std::ofstream out(path);
+        out << "(a \"b\") #(c)";
+    }
+
+    VM::push_frame();
+    parse_file(path);
+    Object objects = VM::peek();
+    REQUIRE(!VM::has_error());
+    REQUIRE(objects.proper_list(2));
+    assert_string(objects.nth(0).nth(1), "b");
+    assert_vector(objects.nth(1), 1);
+
+    std::remove(path.c_str());
+    parse_file(path);
+    REQUIRE(VM::has_error());
+    VM::set_error(Object::Undefined);
+    VM::pop_frame();
+}
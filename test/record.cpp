@@ -0,0 +1,122 @@
+#include <sstream>
+
+#include "catch.h"
+#include "test.h"
+
+#include "gc.h"
+#include "object.h"
+#include "vm.h"
+
+
+TEST_CASE("Record types", "[record]") {
+    VM::push_frame();
+
+    Object point = VM::RecordType("point", {"x", "y"});
+    REQUIRE(point.type() == Type::RecordType);
+    assert_symbol(point.record_name(), "point");
+    assert_vector(point.record_fields(), 2);
+    REQUIRE(point.field_index(VM::Intern("x")) == 0);
+    REQUIRE(point.field_index(VM::Intern("y")) == 1);
+    REQUIRE(point.field_index(VM::Intern("z")) == 2);
+    assert_tostring(point, "#<record-type point>");
+
+#ifndef BRIM_ASSERT_CHECKS
+    VM::push(Object::False);
+    Op::record_type(0);
+    REQUIRE(VM::has_error());
+    VM::set_error(Object::Undefined);
+#endif
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Record instances", "[record]") {
+    VM::push_frame();
+
+    Object point = VM::RecordType("point", {"x", "y"});
+    Object other = VM::RecordType("point", {"x", "y"});
+
+    VM::push(point);
+    VM::push(VM::Fixnum(1));
+    VM::push(VM::Fixnum(2));
+    Op::record(2);
+    Object p = VM::peek();
+    REQUIRE(p.type() == Type::Record);
+    REQUIRE(p.record_type() == point);
+    REQUIRE(p.nslots() == 2);
+    assert_tostring(p, "#<point>");
+
+    Op::record_ref(point, 1);
+    assert_fixnum(VM::peek(), 2);
+    VM::pop();
+
+    VM::push(p);
+    VM::String("new");
+    Op::record_set(point, 0);
+    REQUIRE(VM::peek() == p);
+    assert_string(p.slots()[0], "new");
+
+    Op::record_p(point);
+    REQUIRE(VM::pop() == Object::True);
+    VM::push(p);
+    Op::record_p(other);
+    REQUIRE(VM::pop() == Object::False);
+
+#ifndef BRIM_ASSERT_CHECKS
+    // Distinct types with the same name do not share instances
+    VM::push(p);
+    Op::record_ref(other, 0);
+    REQUIRE(VM::has_error());
+    REQUIRE(VM::pop().undefined());
+    VM::set_error(Object::Undefined);
+
+    // Unknown fields index one past the last slot
+    VM::push(p);
+    Op::record_ref(point, point.field_index(VM::Intern("z")));
+    REQUIRE(VM::has_error());
+    REQUIRE(VM::pop().undefined());
+    VM::set_error(Object::Undefined);
+
+    VM::push(p);
+    VM::push(VM::Fixnum(3));
+    Op::record_set(point, 2);
+    REQUIRE(VM::has_error());
+    REQUIRE(VM::pop().undefined());
+    VM::set_error(Object::Undefined);
+
+    VM::push(point);
+    VM::push(VM::Fixnum(1));
+    Op::record(1);
+    REQUIRE(VM::has_error());
+    VM::set_error(Object::Undefined);
+#endif
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Record slots survive collection", "[record]") {
+    VM::push_frame();
+
+    Object node = VM::RecordType("node", {"value", "next"});
+    VM::push(node);
+    VM::String("tail");
+    VM::push(Object::EmptyList);
+    Op::record(2);
+    for (int i = 0; i < 2000; i++) {
+        Object next = VM::pop();
+        VM::push(node);
+        VM::push(VM::Fixnum(i));
+        VM::push(next);
+        Op::record(2);
+    }
+
+    GC::collect();
+    Object obj = VM::peek();
+    for (int i = 1999; i >= 0; i--) {
+        assert_fixnum(obj.slots()[0], i);
+        obj = obj.slots()[1];
+    }
+    assert_string(obj.slots()[0], "tail");
+
+    VM::pop_frame();
+}
@@ -0,0 +1,87 @@
+#include <map>
+#include <sstream>
+
+#include "catch.h"
+#include "test.h"
+
+#include "object.h"
+#include "vm.h"
+
+
+TEST_CASE("Eq table", "[table]") {
+    VM::push_frame();
+
+    Object table = VM::Table(Equivalence::Eq);
+    table.table_set(VM::Intern("a"), VM::Fixnum(1));
+    table.table_set(VM::Intern("b"), VM::Fixnum(2));
+    table.table_set(VM::Intern("a"), VM::Fixnum(3));
+
+    REQUIRE(table.table_count() == 2);
+    assert_fixnum(table.table_ref(VM::Intern("a")), 3);
+    assert_fixnum(table.table_ref(VM::Intern("b")), 2);
+    REQUIRE(table.table_ref(VM::Intern("c")).undefined());
+    REQUIRE(table.table_ref(VM::String("a"), Object::False) == Object::False);
+    assert_tostring(table, "#<table 2>");
+
+    VM::pop_frame();
+}
+
+TEST_CASE("String and equal tables", "[table]") {
+    VM::push_frame();
+
+    Object strings = VM::Table(Equivalence::String);
+    strings.table_set(VM::String("key"), VM::Fixnum(1));
+    assert_fixnum(strings.table_ref(VM::String("key")), 1);
+    REQUIRE(strings.table_ref(VM::String("kex")).undefined());
+    REQUIRE(strings.table_ref(VM::Fixnum(1)).undefined());
+    REQUIRE(strings.table_ref(VM::Intern("key")).undefined());
+    REQUIRE(!strings.table_delete(VM::Fixnum(1)));
+    REQUIRE(strings.table_count() == 1);
+
+    Object table = VM::Table(Equivalence::Equal);
+    Object key = VM::List({VM::Intern("a"), VM::String("b"), VM::Integer(INT64_MAX)});
+    table.table_set(key, VM::Fixnum(1));
+    Object other = VM::List({VM::Intern("a"), VM::String("b"), VM::Integer(INT64_MAX)});
+    REQUIRE(other != key);
+    assert_fixnum(table.table_ref(other), 1);
+
+    Object eqv = VM::Table(Equivalence::Eqv);
+    eqv.table_set(VM::Integer(INT64_MAX), VM::Fixnum(2));
+    assert_fixnum(eqv.table_ref(VM::Integer(INT64_MAX)), 2);
+    REQUIRE(eqv.table_ref(VM::Integer(INT64_MIN)).undefined());
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Table growth and deletion", "[table]") {
+    VM::push_frame();
+
+    Object table = VM::Table(Equivalence::Equal);
+    std::map<int64_t, int64_t> reference;
+    for (int64_t i = 0; i < 5000; i++) {
+        VM::push_frame();
+        table.table_set(VM::String(std::to_string(i * 7919 % 3001)), VM::Fixnum(i));
+        VM::pop_frame();
+        reference[i * 7919 % 3001] = i;
+        if (i % 3 == 0) {
+            VM::push_frame();
+            REQUIRE(table.table_delete(VM::String(std::to_string(i % 1500))) ==
+                    (reference.erase(i % 1500) == 1));
+            VM::pop_frame();
+        }
+    }
+
+    REQUIRE(table.table_count() == reference.size());
+    VM::push_frame();
+    for (int64_t i = 0; i < 3001; i++) {
+        Object value = table.table_ref(VM::String(std::to_string(i)));
+        auto it = reference.find(i);
+        if (it == reference.end())
+            REQUIRE(value.undefined());
+        else
+            assert_fixnum(value, it->second);
+    }
+    VM::pop_frame();
+
+    VM::pop_frame();
+}
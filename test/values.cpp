@@ -0,0 +1,97 @@
+#include "catch.h"
+#include "test.h"
+
+#include "gc.h"
+#include "object.h"
+#include "vm.h"
+
+
+// Return the quotient and remainder of two fixnums
+static void divmod(int64_t a, int64_t b)
+{
+    VM::push_frame();
+    VM::push(VM::Fixnum(a / b));
+    VM::push(VM::Fixnum(a % b));
+    Op::ret_values(2);
+}
+
+TEST_CASE("Multiple values", "[values]") {
+    VM::push_frame();
+    VM::push(Object::True);
+    std::size_t objects = GC::size();
+
+    int64_t sum = 0;
+    Op::call_with_values(
+        [] { VM::push(Object::False); divmod(17, 5); Op::ret_values(2); },
+        [&] (std::size_t nvalues) {
+            REQUIRE(nvalues == 2);
+            assert_fixnum(VM::peek(1), 3);
+            assert_fixnum(VM::peek(0), 2);
+            sum = VM::peek(1).fixnum() + VM::peek(0).fixnum();
+            VM::pop(nvalues);
+        });
+    REQUIRE(sum == 5);
+    REQUIRE(GC::size() == objects);
+    REQUIRE(VM::stack_size() == 1);
+
+    // Zero values
+    Op::call_with_values(
+        [] { Op::ret_values(0); },
+        [] (std::size_t nvalues) { REQUIRE(nvalues == 0); });
+    REQUIRE(VM::stack_size() == 1);
+
+    // A single value through an ordinary return
+    Op::call_with_values(
+        [] { VM::push(VM::Fixnum(7)); Op::ret(); },
+        [] (std::size_t nvalues) {
+            REQUIRE(nvalues == 1);
+            assert_fixnum(VM::peek(), 7);
+            VM::pop();
+        });
+    REQUIRE(VM::pop() == Object::True);
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Multiple values and errors", "[values]") {
+    VM::push_frame();
+
+    Op::call_with_values(
+        [] {
+            VM::push(VM::Fixnum(1));
+            Op::intern("sig");
+            Op::string("failed");
+            Op::error();
+            Op::ret_values(3);
+        },
+        [] (std::size_t nvalues) {
+            REQUIRE(nvalues == 1);
+            REQUIRE(VM::has_error());
+        });
+    VM::set_error(Object::Undefined);
+
+    // Claiming more values than the frame holds
+    Op::call_with_values(
+        [] { VM::push(VM::Fixnum(1)); Op::ret_values(2); },
+        [] (std::size_t nvalues) {
+            REQUIRE(nvalues == 1);
+            REQUIRE(VM::has_error());
+            REQUIRE(VM::pop().undefined());
+        });
+    VM::set_error(Object::Undefined);
+
+    VM::pop_frame();
+}
+
+TEST_CASE("Discarding a frame resets the value count", "[values]") {
+    VM::push_frame();
+
+    Op::call_with_values(
+        [] { Op::ret_values(0); },
+        [] (std::size_t nvalues) { REQUIRE(nvalues == 0); });
+    VM::push_frame();
+    VM::pop_frame();
+    REQUIRE(VM::nvalues() == 1);
+
+    VM::pop_frame();
+}